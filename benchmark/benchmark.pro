@@ -0,0 +1,36 @@
+#-------------------------------------------------
+#
+# End-to-end benchmark of Pons against a local stand-in server
+#
+#-------------------------------------------------
+
+QT       += core gui network
+
+TARGET = benchmark
+TEMPLATE = app
+CONFIG += console
+
+INCLUDEPATH += ..
+
+SOURCES += main.cpp \
+    ponsserver.cpp \
+    ../webdict.cpp \
+    ../pons.cpp \
+    ../htmlparser.cpp \
+    ../treemodel.cpp \
+    ../treeitem.cpp \
+    ../responsecache.cpp \
+    ../lookupstore.cpp \
+    ../stringpool.cpp \
+    ../treearena.cpp
+
+HEADERS  += ponsserver.h \
+    ../webdict.h \
+    ../pons.h \
+    ../htmlparser.h \
+    ../treemodel.h \
+    ../treeitem.h \
+    ../responsecache.h \
+    ../lookupstore.h \
+    ../stringpool.h \
+    ../treearena.h
@@ -0,0 +1,76 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LEGACYPONS_H
+#define LEGACYPONS_H
+
+#include "../treeitem.h"
+
+#include <QMap>
+#include <QString>
+
+class LegacyPons
+	// Pons::parse as it was before the cursor rewrite and the UTF-8 path: QString, regular expressions, detach()
+	// kept as the reference the current parser has to give identical trees to; it differs from the original in:
+	// - it builds a detached tree instead of rows of the model
+	// - header() appends one parent for a headword equal to the main word without a speech part;
+	//   the original appended an invalid index too, so later sections went to the top level of the model
+	// - prepareText() decodes the same entities as Pons::prepareText(), the original decoded &#39; only
+{
+public:
+	LegacyPons(StringPool::Id targetLang);
+	void parse(const QByteArray &data, TreeItem *root);
+	
+private:
+	void prepareText(QString &text);
+	
+	WordClass getSpeechPart(const QString &text, int pos);
+	QString getSource(const QString &text, int &pos);
+	QString getTarget(const QString &text, int &pos);
+	QString getSense(const QString &text);
+	QString getPlural(const QString &text);
+	Gender getGender(const QString &text);
+	
+	bool header(const QString &text, const QString &sourceWord, QList<TreeItem*> &parents);
+	void finalLevel(const QString &text, const QList<TreeItem*> &parents);
+	
+	QMap<QString, WordClass> strToSpeechPart;
+	StringPool::Id targetLang;
+};
+
+#endif // LEGACYPONS_H
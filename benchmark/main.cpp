@@ -0,0 +1,180 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+// end-to-end benchmark of a dictionary: query -> download -> parse -> model insert
+// runs Pons against a local stand-in server, so pons.eu is never asked
+//
+// usage: benchmark [-words N] [-latency MS] [-jitter MS] [-requests N] [-pages DIR]
+//   -pages     directory of recorded mobile-results pages (<word>.html), a built-in page if not given
+//   -requests  requests sent at the same time by WebDict
+//
+// reports words per second and p50/p95/p99 latency from the arrival of a request
+// at the server to the insertion of the translation tree into the model
+
+#include "ponsserver.h"
+#include "../pons.h"
+#include "../treemodel.h"
+
+#include <QApplication>
+#include <QDesktopServices>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+#include <QtAlgorithms>
+
+class Benchmark : public QObject
+{
+	Q_OBJECT
+public:
+	Benchmark(int words) : words(words) { timer.start(); }
+	
+	QElapsedTimer timer;
+	
+public slots:
+	void requested(const QString &word)
+	{
+		sent.insert(word, timer.elapsed());
+	}
+	
+	void rowsInserted(const QModelIndex &parent, int first, int last)
+	{
+		Q_UNUSED(first);
+		Q_UNUSED(last);
+		// translation trees are attached to main words at once
+		if (!parent.isValid() || parent.parent().isValid())
+			return;
+		QString word = parent.data(Qt::EditRole).toString();
+		if (sent.contains(word))
+			latencies.append(timer.elapsed() - sent.take(word));
+	}
+	
+	void completed()
+	{
+		double seconds = timer.elapsed() / 1000.0;
+		qSort(latencies);
+		
+		QTextStream out(stdout);
+		out << "words:        " << words << "\n"
+			<< "translated:   " << latencies.size() << "\n"
+			<< "time:         " << seconds << " s\n"
+			<< "words/sec:    " << (seconds > 0 ? latencies.size() / seconds : 0) << "\n"
+			<< "latency p50:  " << percentile(0.50) << " ms\n"
+			<< "latency p95:  " << percentile(0.95) << " ms\n"
+			<< "latency p99:  " << percentile(0.99) << " ms\n";
+		out.flush();
+		
+		QCoreApplication::exit(latencies.isEmpty() ? 1 : 0);
+	}
+	
+private:
+	// nearest-rank, in milliseconds
+	qint64 percentile(double p) const
+	{
+		if (latencies.isEmpty())
+			return 0;
+		int rank = qBound(0, int(p * latencies.size() + 0.999999) - 1, latencies.size() - 1);
+		return latencies.at(rank);
+	}
+	
+	int words;
+	QHash<QString, qint64> sent;
+	QVector<qint64> latencies;
+};
+
+namespace
+{
+	int option(const QStringList &args, const QString &name, int value)
+	{
+		int i = args.indexOf(name);
+		return (i != -1 && i + 1 < args.size()) ? args.at(i + 1).toInt() : value;
+	}
+	
+	// a clean cache, so every word is really downloaded
+	void removeDirectory(const QString &path)
+	{
+		QDirIterator it(path, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+		while (it.hasNext())
+			QFile::remove(it.next());
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QApplication app(argc, argv, false);
+	app.setApplicationName("translator-benchmark");
+	removeDirectory(QDesktopServices::storageLocation(QDesktopServices::CacheLocation));
+	
+	QStringList args = app.arguments();
+	int words = option(args, "-words", 1000);
+	int pagesIndex = args.indexOf("-pages");
+	
+	PonsServer server;
+	server.setLatency(option(args, "-latency", 50), option(args, "-jitter", 20));
+	if (pagesIndex != -1 && pagesIndex + 1 < args.size() && !server.loadPages(args.at(pagesIndex + 1)))
+		QTextStream(stderr) << "no pages in " << args.at(pagesIndex + 1) << ", the built-in page is used\n";
+	if (!server.listen(QHostAddress::LocalHost))
+	{
+		QTextStream(stderr) << "can not listen: " << server.errorString() << "\n";
+		return 1;
+	}
+	
+	TreeModel model;
+	Pons pons(&model);
+	pons.setWebsite(QUrl(QString("http://127.0.0.1:%1").arg(server.serverPort())));
+	pons.setMaxRequests(option(args, "-requests", pons.getMaxRequests()));
+	pons.setLang("DE", "PL");
+	
+	QStringList list;
+	for (int i = 0; i < words; i++)
+		list.append(QString("wort%1").arg(i, 4, 10, QChar('0')));
+	
+	Benchmark benchmark(words);
+	QObject::connect(&server, SIGNAL(requested(QString)), &benchmark, SLOT(requested(QString)));
+	QObject::connect(&model, SIGNAL(rowsInserted(QModelIndex,int,int)), &benchmark, SLOT(rowsInserted(QModelIndex,int,int)));
+	QObject::connect(&model, SIGNAL(translate(QModelIndex)), &pons, SLOT(translate(QModelIndex)));
+	QObject::connect(&pons, SIGNAL(completed()), &benchmark, SLOT(completed()));
+	
+	pons.addWords(list);
+	
+	return app.exec();
+}
+
+#include "main.moc"
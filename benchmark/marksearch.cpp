@@ -0,0 +1,259 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+// correctness and speed of HtmlParser::indexOf, the block-wise search of short ASCII marks
+//
+// usage: marksearch [-pages DIR]
+//   -pages  directory of recorded mobile-results pages (*.html), a generated page if not given
+//
+// first compares HtmlParser::indexOf with QByteArray::indexOf and QString::indexOf, which are scalar:
+// a mark at every position of short buffers (at the edges and across 16-byte blocks), near misses
+// with only the first and the last character matching, and every occurrence of marks in the pages;
+// then reports MB/s of both searches for the marks Pons looks for; exits with 1 on a difference
+
+#include "../htmlparser.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+namespace
+{
+	// marks searched by Pons::parse and a single character as in the underline scanner
+	const char *const marks[] = { "<", "</tr>", "<tr id", "target", "romhead", "wordclass", "</h2>", 0 };
+	
+	int failures = 0;
+	
+	void report(const char *type, const char *mark, int from, int size, int expected, int found)
+	{
+		if (expected == found)
+			return;
+		failures++;
+		if (failures <= 20)
+			QTextStream(stderr) << type << " '" << mark << "' from " << from << " in " << size
+								<< ": expected " << expected << ", found " << found << "\n";
+	}
+	
+	void checkBytes(const QByteArray &data, const char *mark, int from)
+	{
+		report("bytes", mark, from, data.size(), data.indexOf(mark, from), HtmlParser::indexOf(data, mark, from));
+	}
+	
+	void checkText(const QString &text, const char *mark, int from)
+	{
+		report("text", mark, from, text.size(), text.indexOf(QLatin1String(mark), from),
+			   HtmlParser::indexOf(text, mark, from));
+	}
+	
+	// a mark or its near miss at every position of buffers up to 3 blocks long, on various fillers
+	void checkEdges()
+	{
+		for (int m = 0; marks[m]; m++)
+		{
+			QByteArray mark = marks[m];
+			int length = mark.size();
+			QByteArray nearMiss = mark;
+			if (length > 2)
+				nearMiss[1] = '#';
+			
+			QByteArray fillers = QByteArray(".<") + mark.at(0) + mark.at(length - 1);
+			for (int f = 0; f < fillers.size(); f++)
+				for (int size = 0; size <= 3 * 16 + 2; size++)
+				{
+					QByteArray empty(size, fillers.at(f));
+					checkBytes(empty, mark, 0);
+					checkText(QString::fromLatin1(empty), mark, 0);
+					
+					for (int pos = 0; pos + length <= size; pos++)
+					{
+						QByteArray data = empty;
+						data.replace(pos, length, mark);
+						QByteArray missed = empty;
+						missed.replace(pos, length, nearMiss);
+						QString text = QString::fromLatin1(data);
+						
+						int froms[] = { 0, pos > 0 ? pos - 1 : 0, pos, pos + 1, size };
+						for (int i = 0; i < 5; i++)
+						{
+							checkBytes(data, mark, froms[i]);
+							checkBytes(missed, mark, froms[i]);
+							checkText(text, mark, froms[i]);
+							checkText(QString::fromLatin1(missed), mark, froms[i]);
+						}
+					}
+				}
+		}
+	}
+	
+	// every occurrence of the marks
+	void checkPage(const QByteArray &page)
+	{
+		QString text = QString::fromUtf8(page);
+		for (int m = 0; marks[m]; m++)
+		{
+			int from = 0;
+			do
+			{
+				checkBytes(page, marks[m], from);
+				from = page.indexOf(marks[m], from);
+			}
+			while (from++ != -1);
+			
+			from = 0;
+			do
+			{
+				checkText(text, marks[m], from);
+				from = text.indexOf(QLatin1String(marks[m]), from);
+			}
+			while (from++ != -1);
+		}
+	}
+	
+	QList<QByteArray> loadPages(const QString &directory)
+	{
+		QList<QByteArray> pages;
+		QDir dir(directory);
+		foreach (const QFileInfo &info, dir.entryInfoList(QStringList() << "*.html" << "*.htm", QDir::Files, QDir::Name))
+		{
+			QFile file(info.filePath());
+			if (file.open(QIODevice::ReadOnly))
+				pages.append(file.readAll());
+		}
+		return pages;
+	}
+	
+	// about 100 kB in the layout of a mobile-results page
+	QByteArray generatedPage()
+	{
+		QByteArray page = "<html><body><div class=\"romhead\"></div>\n";
+		for (int i = 0; page.size() < 100000; i++)
+			page += QString("<h2>wort%1 <span class=\"wordclass\">noun</span></h2>\n"
+							"<table><tr id=\"t%1\"><td class=\"source\">wort%1</td>"
+							"<td class=\"target\">s\xc5\x82owo %1</td></tr></table>\n").arg(i).toUtf8();
+		return page + "</body></html>\n";
+	}
+	
+	// counts all occurrences of the marks, so both searches do the same work
+	int countQt(const QByteArray &text, const char *mark)
+	{
+		int count = 0;
+		for (int i = text.indexOf(mark); i != -1; i = text.indexOf(mark, i + 1))
+			count++;
+		return count;
+	}
+	
+	int countQt(const QString &text, const char *mark)
+	{
+		int count = 0;
+		QLatin1String latin(mark);
+		for (int i = text.indexOf(latin); i != -1; i = text.indexOf(latin, i + 1))
+			count++;
+		return count;
+	}
+	
+	template <typename Text>
+	int countMarks(const Text &text, const char *mark)
+	{
+		int count = 0;
+		for (int i = HtmlParser::indexOf(text, mark); i != -1; i = HtmlParser::indexOf(text, mark, i + 1))
+			count++;
+		return count;
+	}
+	
+	volatile int sink;
+	
+	// MB/s of walking all marks through all texts
+	template <typename Text>
+	double speed(const QList<Text> &texts, bool qt)
+	{
+		qint64 bytes = 0;
+		QElapsedTimer timer;
+		timer.start();
+		// at least 200 ms, so the millisecond timer is precise enough
+		while (timer.elapsed() < 200)
+		{
+			foreach (const Text &text, texts)
+				for (int m = 0; marks[m]; m++)
+				{
+					sink += qt ? countQt(text, marks[m]) : countMarks(text, marks[m]);
+					bytes += text.size() * sizeof(text.at(0));
+				}
+		}
+		return bytes / (timer.elapsed() / 1000.0) / (1024 * 1024);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+	int i = args.indexOf("-pages");
+	
+	QList<QByteArray> pages;
+	if (i != -1 && i + 1 < args.size())
+		pages = loadPages(args.at(i + 1));
+	if (pages.isEmpty())
+		pages.append(generatedPage());
+	
+	QTextStream out(stdout);
+	
+	checkEdges();
+	foreach (const QByteArray &page, pages)
+		checkPage(page);
+	if (failures)
+	{
+		out << failures << " differences from the scalar search\n";
+		return 1;
+	}
+	out << "no differences from the scalar search\n";
+	
+	QList<QString> texts;
+	foreach (const QByteArray &page, pages)
+		texts.append(QString::fromUtf8(page));
+	
+	out << "MB/s                    Qt    HtmlParser\n"
+		<< "UTF-8 (QByteArray)  " << qSetFieldWidth(8) << speed(pages, true) << speed(pages, false)
+		<< qSetFieldWidth(0) << "\n"
+		<< "UTF-16 (QString)    " << qSetFieldWidth(8) << speed(texts, true) << speed(texts, false)
+		<< qSetFieldWidth(0) << "\n";
+	
+	return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Correctness check and benchmark of HtmlParser::indexOf
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = marksearch
+TEMPLATE = app
+CONFIG += console
+
+INCLUDEPATH += ..
+
+SOURCES += marksearch.cpp \
+    ../htmlparser.cpp
+
+HEADERS  += ../htmlparser.h
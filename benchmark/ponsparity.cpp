@@ -0,0 +1,128 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+// checks that Pons::parse gives the same trees as the parser before the cursor rewrite (LegacyPons)
+// on recorded pages, so changes of the parser do not change translations unnoticed
+//
+// usage: ponsparity [-pages DIR] [-source DE] [-target PL]
+//   -pages  directory of recorded mobile-results pages, <word>.html; benchmark/pages by default
+//
+// prints the first difference of each page which differs and exits with 1 if there is any
+
+#include "legacypons.h"
+#include "../pons.h"
+#include "../treemodel.h"
+
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+
+namespace
+{
+	QString option(const QStringList &args, const QString &name, const QString &value)
+	{
+		int i = args.indexOf(name);
+		return (i != -1 && i + 1 < args.size()) ? args.at(i + 1) : value;
+	}
+	
+	// fields and children of both trees, reports the first difference by the path of rows
+	bool compare(TreeItem *before, TreeItem *now, const QString &path, QTextStream &out)
+	{
+		if (before->itemData() != now->itemData())
+		{
+			out << "  " << path << ": \"" << before->display() << "\" before, \"" << now->display() << "\" now\n";
+			return 0;
+		}
+		if (before->childrenCount() != now->childrenCount())
+		{
+			out << "  " << path << " \"" << now->display() << "\": " << before->childrenCount() << " children before, "
+				<< now->childrenCount() << " now\n";
+			return 0;
+		}
+		for (int i = 0; i < now->childrenCount(); i++)
+			if (!compare(before->child(i), now->child(i), path + "/" + QString::number(i), out))
+				return 0;
+		return 1;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QApplication app(argc, argv, false);
+	app.setApplicationName("translator-ponsparity");
+	
+	QStringList args = app.arguments();
+	QString pages = option(args, "-pages", "pages");
+	QTextStream out(stdout);
+	
+	TreeModel model;
+	Pons pons(&model);
+	pons.setLang(option(args, "-source", "DE"), option(args, "-target", "PL"));
+	LegacyPons legacy(StringPool::intern(model.getTargetLang()));
+	
+	int checked = 0;
+	int differ = 0;
+	QDir dir(pages);
+	foreach (const QFileInfo &info, dir.entryInfoList(QStringList() << "*.html" << "*.htm", QDir::Files, QDir::Name))
+	{
+		QFile file(info.filePath());
+		if (!file.open(QIODevice::ReadOnly))
+			continue;
+		QByteArray page = file.readAll();
+		
+		// the main word as WebDict gives it to parse()
+		QModelIndex word = model.addMainWord(info.completeBaseName());
+		TreeItem before(NULL);
+		before.setItemData(model.itemData(word));
+		TreeItem now(NULL);
+		now.setItemData(model.itemData(word));
+		now.useArena();
+		
+		legacy.parse(page, &before);
+		pons.parse(page, &now);
+		
+		checked++;
+		if (!compare(&before, &now, info.fileName(), out))
+			differ++;
+	}
+	
+	out << checked << " pages, " << differ << " with different trees\n";
+	return (differ || !checked) ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+#-------------------------------------------------
+#
+# Check of Pons::parse against the parser before the cursor rewrite
+#
+#-------------------------------------------------
+
+QT       += core gui network
+
+TARGET = ponsparity
+TEMPLATE = app
+CONFIG += console
+
+INCLUDEPATH += ..
+
+SOURCES += ponsparity.cpp \
+    legacypons.cpp \
+    ../webdict.cpp \
+    ../pons.cpp \
+    ../htmlparser.cpp \
+    ../treemodel.cpp \
+    ../treeitem.cpp \
+    ../responsecache.cpp \
+    ../lookupstore.cpp \
+    ../stringpool.cpp \
+    ../treearena.cpp
+
+HEADERS  += legacypons.h \
+    ../webdict.h \
+    ../pons.h \
+    ../htmlparser.h \
+    ../treemodel.h \
+    ../treeitem.h \
+    ../responsecache.h \
+    ../lookupstore.h \
+    ../stringpool.h \
+    ../treearena.h
@@ -0,0 +1,158 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "ponsserver.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+#include <QUrl>
+
+namespace
+{
+	// one entry in the layout of a mobile-results page, %1 is the word
+	const char builtInPage[] =
+		"<html><body><div class=\"romhead\"></div>\n"
+		"<h2>%1 <span class=\"wordclass\">noun</span> <span class=\"genus\">m</span></h2>\n"
+		"<table><thead><tr><th><span class=\"sense\">general</span></th></tr></thead>\n"
+		"<tr id=\"t1\"><td class=\"source\">%1</td><td class=\"target\">%1 translated</td></tr>\n"
+		"<tr id=\"t2\"><td class=\"source\">a %1</td><td class=\"target\">a %1 translated</td></tr>\n"
+		"</table></body></html>\n";
+}
+
+PonsServer::PonsServer(QObject *parent) : QTcpServer(parent)
+{
+	next = 0;
+	latency = 0;
+	jitter = 0;
+}
+
+int PonsServer::loadPages(const QString &directory)
+{
+	QDir dir(directory);
+	foreach (const QFileInfo &info, dir.entryInfoList(QStringList() << "*.html" << "*.htm", QDir::Files, QDir::Name))
+	{
+		QFile file(info.filePath());
+		if (!file.open(QIODevice::ReadOnly))
+			continue;
+		QByteArray data = file.readAll();
+		pages.insert(info.completeBaseName(), data);
+		pageList.append(data);
+	}
+	return pageList.size();
+}
+
+void PonsServer::setLatency(int latency, int jitter)
+{
+	this->latency = qMax(0, latency);
+	this->jitter = qMax(0, jitter);
+}
+
+void PonsServer::incomingConnection(int socketDescriptor)
+{
+	QTcpSocket *socket = new QTcpSocket(this);
+	if (!socket->setSocketDescriptor(socketDescriptor))
+	{
+		delete socket;
+		return;
+	}
+	connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+	connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+}
+
+QByteArray PonsServer::page(const QString &word)
+{
+	QHash<QString, QByteArray>::const_iterator it = pages.constFind(word);
+	if (it != pages.constEnd())
+		return it.value();
+	
+	if (!pageList.isEmpty())
+	{
+		next = (next + 1) % pageList.size();
+		return pageList.at(next);
+	}
+	
+	return QString(builtInPage).arg(word).toUtf8();
+}
+
+void PonsServer::readRequest()
+{
+	QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+	if (!socket)
+		return;
+	
+	// requests may come in parts, the rest is kept with the socket
+	QByteArray buffer = socket->property("request").toByteArray() + socket->readAll();
+	int end;
+	while ((end = buffer.indexOf("\r\n\r\n")) != -1)
+	{
+		// "GET /dict/search/mobile-results/?q=word&l=depl HTTP/1.1"
+		QByteArray requestLine = buffer.left(buffer.indexOf("\r\n"));
+		buffer.remove(0, end + 4);
+		
+		QUrl url = QUrl::fromEncoded(requestLine.split(' ').value(1));
+		QString word = url.queryItemValue("q");
+		emit requested(word);
+		
+		QByteArray body = page(word);
+		QByteArray reply = "HTTP/1.1 200 OK\r\n"
+			"Content-Type: text/html; charset=utf-8\r\n"
+			"Cache-Control: no-cache\r\n"
+			"Connection: keep-alive\r\n"
+			"Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+		
+		int delay = latency;
+		if (jitter)
+			delay += qrand() % (2 * jitter + 1) - jitter;
+		new DelayedReply(socket, reply, qMax(0, delay));
+	}
+	socket->setProperty("request", buffer);
+}
+
+DelayedReply::DelayedReply(QTcpSocket *socket, const QByteArray &data, int delay) :
+	QObject(socket), socket(socket), data(data)
+{
+	QTimer::singleShot(delay, this, SLOT(send()));
+}
+
+void DelayedReply::send()
+{
+	if (socket)
+		socket->write(data);
+	deleteLater();
+}
@@ -0,0 +1,97 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef PONSSERVER_H
+#define PONSSERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QHash>
+#include <QStringList>
+
+class PonsServer : public QTcpServer
+	// local stand-in for mobile.pons.eu, replays recorded /dict/search/mobile-results/ pages
+	// every reply is delayed by 'latency' +/- 'jitter' milliseconds like on a real network
+{
+	Q_OBJECT
+public:
+	explicit PonsServer(QObject *parent = 0);
+	
+	// pages are files named <word>.html, other words get them in turn
+	// if there are none, a built-in page with one entry is sent; returns the number of pages
+	int loadPages(const QString &directory);
+	
+	void setLatency(int latency, int jitter);
+	
+signals:
+	// a request for 'word' has arrived
+	void requested(const QString &word);
+	
+protected:
+	void incomingConnection(int socketDescriptor);
+	
+private slots:
+	void readRequest();
+	
+private:
+	QByteArray page(const QString &word);
+	
+	QHash<QString, QByteArray> pages;
+	QList<QByteArray> pageList;
+	int next; // of pageList for other words
+	int latency;
+	int jitter;
+};
+
+class DelayedReply : public QObject
+	// sends a reply after a delay, the connection may be closed in the meantime
+{
+	Q_OBJECT
+public:
+	DelayedReply(QTcpSocket *socket, const QByteArray &data, int delay);
+	
+private slots:
+	void send();
+	
+private:
+	QPointer<QTcpSocket> socket;
+	QByteArray data;
+};
+
+#endif // PONSSERVER_H
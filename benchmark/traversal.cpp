@@ -0,0 +1,136 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+// cost of walking a translation tree the way QTreeView does: index(), parent() and data() of every
+// target word under a main word with a growing number of children; parent() of a target word has to
+// give the row of its parent among all the children, so with O(1) childNumber() the cost per row stays flat
+// the second column simulates the old lookup: the same walk plus a QList::indexOf() of every parent
+// among its siblings, as childNumber() did before; the tree is unchanged, so it is only a baseline
+//
+// usage: traversal [-max N]   (fan-outs 10, 100, ... up to N, 100000 by default)
+
+#include "../treemodel.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+namespace
+{
+	// results of the walks, so they are not optimized out
+	volatile int sink;
+	
+	// a main word with 'fanOut' translations, attached at once like a parsed tree
+	QModelIndex build(TreeModel &model, int fanOut)
+	{
+		model.setLang("de", "pl");
+		QModelIndex word = model.addMainWord("Haus");
+		
+		TreeItem tree(NULL);
+		tree.setItemData(model.itemData(word));
+		tree.useArena();
+		StringPool::Id lang = StringPool::intern("pl");
+		for (int i = 0; i < fanOut; i++)
+			tree.addStdWord(QString("Haus %1").arg(i), STD)->addTargetWord(QString("dom %1").arg(i), lang);
+		
+		model.attachChildren(word, &tree);
+		return word;
+	}
+	
+	// returns a value depending on all the calls
+	// if 'siblings' are given, the row of the parent is also looked up in them like childNumber() did
+	int walk(const TreeModel &model, const QModelIndex &word, const QList<void*> *siblings)
+	{
+		int check = 0;
+		int rows = model.rowCount(word);
+		for (int i = 0; i < rows; i++)
+		{
+			QModelIndex target = model.index(0, 0, model.index(i, 0, word));
+			QModelIndex parent = model.parent(target);
+			check += parent.row() + model.data(target, Qt::DisplayRole).toString().size();
+			if (siblings)
+				check += siblings->indexOf(parent.internalPointer());
+		}
+		return check;
+	}
+	
+	// ns per row
+	double measure(const TreeModel &model, const QModelIndex &word, const QList<void*> *siblings)
+	{
+		int fanOut = model.rowCount(word);
+		// at least a million rows walked, so the millisecond timer is precise enough
+		int repeats = qMax(1, 1000000 / fanOut);
+		// the search is linear, so fewer walks are enough for large fan-outs, but never more
+		if (siblings)
+			repeats = qMin(repeats, qMax(1, repeats * 100 / fanOut));
+		QElapsedTimer timer;
+		timer.start();
+		for (int r = 0; r < repeats; r++)
+			sink += walk(model, word, siblings);
+		return timer.elapsed() * 1e6 / ((double)repeats * fanOut);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+	int i = args.indexOf("-max");
+	int max = (i != -1 && i + 1 < args.size()) ? args.at(i + 1).toInt() : 100000;
+	
+	QTextStream out(stdout);
+	out << "fan-out     ns/row    with indexOf (simulated)\n";
+	
+	for (int fanOut = 10; fanOut <= max; fanOut *= 10)
+	{
+		TreeModel model;
+		QModelIndex word = build(model, fanOut);
+		
+		QList<void*> siblings;
+		for (int row = 0; row < fanOut; row++)
+			siblings.append(model.index(row, 0, word).internalPointer());
+		
+		out << qSetFieldWidth(7) << fanOut << qSetFieldWidth(0) << "     "
+			<< qSetFieldWidth(10) << left << measure(model, word, 0)
+			<< measure(model, word, &siblings) << qSetFieldWidth(0) << right << "\n";
+		out.flush();
+	}
+	
+	return 0;
+}
@@ -0,0 +1,24 @@
+#-------------------------------------------------
+#
+# Benchmark of walking TreeModel like a view does
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = traversal
+TEMPLATE = app
+CONFIG += console
+
+INCLUDEPATH += ..
+
+SOURCES += traversal.cpp \
+    ../treemodel.cpp \
+    ../treeitem.cpp \
+    ../stringpool.cpp \
+    ../treearena.cpp
+
+HEADERS  += ../treemodel.h \
+    ../treeitem.h \
+    ../stringpool.h \
+    ../treearena.h
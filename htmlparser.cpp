@@ -38,17 +38,205 @@
 
 #include "htmlparser.h"
 #include <QRegExp>
+#include <QHash>
+#include <QPair>
+#include <QReadWriteLock>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HTMLPARSER_SSE2
+#include <emmintrin.h>
+#endif
+
+// ------------------- character access ---------------------
+
+namespace
+{
+	inline ushort code(QChar c)	{ return c.unicode(); }
+	inline ushort code(char c)	{ return (uchar)c; }
+}
+
+// ------------------- mark search ---------------------
+
+// Marks searched in html are short ASCII strings. Whole blocks of text are compared
+// with the first and the last character of the mark at once, and only positions
+// where both match are compared character by character.
+
+namespace
+{
+	template <typename Char>
+	inline bool equalsMark(const Char *p, const char *mark, int length)
+	{
+		for (int i = 0; i < length; i++)
+			if (code(p[i]) != (uchar)mark[i])
+				return false;
+		return true;
+	}
+	
+	template <typename Char>
+	int scalarIndexOf(const Char *data, int size, const char *mark, int length, int from)
+	{
+		for (int i = from; i <= size - length; i++)
+			if (code(data[i]) == (uchar)mark[0] && equalsMark(data + i, mark, length))
+				return i;
+		return -1;
+	}
+
+#ifdef HTMLPARSER_SSE2
+	inline int lowestBit(uint mask)
+	{
+#ifdef __GNUC__
+		return __builtin_ctz(mask);
+#else
+		int bit = 0;
+		while (!(mask & 1))
+		{
+			mask >>= 1;
+			bit++;
+		}
+		return bit;
+#endif
+	}
+	
+	// UTF-16: 8 characters per block, two mask bits per character
+	int blockIndexOf(const QChar *data, int size, const char *mark, int length, int from)
+	{
+		const __m128i first = _mm_set1_epi16((uchar)mark[0]);
+		const __m128i last = _mm_set1_epi16((uchar)mark[length - 1]);
+		
+		int i = from;
+		for (; i + length - 1 + 8 <= size; i += 8)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(data + i + length - 1));
+			uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, first), _mm_cmpeq_epi16(b, last)));
+			while (mask)
+			{
+				int bit = lowestBit(mask);
+				if (equalsMark(data + i + bit / 2, mark, length))
+					return i + bit / 2;
+				mask &= ~(3u << bit);
+			}
+		}
+		return scalarIndexOf(data, size, mark, length, i);
+	}
+	
+	// UTF-8: 16 bytes per block
+	int blockIndexOf(const char *data, int size, const char *mark, int length, int from)
+	{
+		const __m128i first = _mm_set1_epi8(mark[0]);
+		const __m128i last = _mm_set1_epi8(mark[length - 1]);
+		
+		int i = from;
+		for (; i + length - 1 + 16 <= size; i += 16)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)(data + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(data + i + length - 1));
+			uint mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+			while (mask)
+			{
+				int bit = lowestBit(mask);
+				if (equalsMark(data + i + bit, mark, length))
+					return i + bit;
+				mask &= mask - 1;
+			}
+		}
+		return scalarIndexOf(data, size, mark, length, i);
+	}
+#endif
+	
+	template <typename Char>
+	int indexOfMark(const Char *data, int size, const char *mark, int from)
+	{
+		int length = qstrlen(mark);
+		if (from < 0)
+			from = 0;
+		if (!length)
+			return from <= size ? from : -1;
+#ifdef HTMLPARSER_SSE2
+		return blockIndexOf(data, size, mark, length, from);
+#else
+		return scalarIndexOf(data, size, mark, length, from);
+#endif
+	}
+}
+
+int HtmlParser::indexOf(const QString &text, const char *mark, int from)
+{
+	return indexOfMark(text.constData(), text.size(), mark, from);
+}
+
+int HtmlParser::indexOf(const QByteArray &text, const char *mark, int from)
+{
+	return indexOfMark(text.constData(), text.size(), mark, from);
+}
+
+// ------------------- compiled expressions cache ---------------------
+
+// extract() and detach() are called with a small, fixed set of marks,
+// so expressions are compiled once per mark and shared afterwards.
+// A copy of QRegExp shares the compiled expression and has its own match state,
+// so every caller works on its own copy and the cache may be used from many threads.
+
+namespace
+{
+	struct ExtractExp
+	{
+		QRegExp whole; // from 'startMark' to 'endMark'
+		QRegExp start; // 'startMark' only
+	};
+	
+	QReadWriteLock expLock;
+	QHash<QPair<QString, QString>, ExtractExp> extractExps;
+	QHash<QString, QRegExp> detachExps;
+	
+	ExtractExp extractExp(const QString &startMark, const QString &endMark)
+	{
+		QPair<QString, QString> key(startMark, endMark);
+		{
+			QReadLocker locker(&expLock);
+			QHash<QPair<QString, QString>, ExtractExp>::const_iterator i = extractExps.constFind(key);
+			if (i != extractExps.constEnd())
+				return i.value();
+		}
+		
+		ExtractExp exp;
+		exp.whole = QRegExp(startMark + ".*(?=" + endMark + ")", Qt::CaseInsensitive);
+		exp.whole.setMinimal(true);
+		exp.start = QRegExp(startMark);
+		exp.start.setMinimal(true);
+		
+		QWriteLocker locker(&expLock);
+		extractExps.insert(key, exp);
+		return exp;
+	}
+	
+	QRegExp detachExp(const QString &pattern)
+	{
+		{
+			QReadLocker locker(&expLock);
+			QHash<QString, QRegExp>::const_iterator i = detachExps.constFind(pattern);
+			if (i != detachExps.constEnd())
+				return i.value();
+		}
+		
+		QRegExp exp("^.*"+pattern);
+		exp.setMinimal(true);
+		
+		QWriteLocker locker(&expLock);
+		detachExps.insert(pattern, exp);
+		return exp;
+	}
+}
 
 QString HtmlParser::extract(const QString &text, const QString &startMark, const QString &endMark, int &pos)
 {
-	QRegExp exp = QRegExp(startMark + ".*(?=" + endMark + ")", Qt::CaseInsensitive);
-	exp.setMinimal(true);
+	ExtractExp e = extractExp(startMark, endMark);
+	QRegExp &exp = e.whole;
 	pos = exp.indexIn(text, pos);
 	if (pos != -1)
 	{
 		QString result = exp.cap(0);
-		QRegExp start = QRegExp(startMark);
-		start.setMinimal(1);
+		QRegExp &start = e.start;
 		start.indexIn(result);
 		result.remove(0,start.cap(0).size());
 		return result;
@@ -70,61 +258,310 @@ int HtmlParser::goBefore(const QString &text, const QString &mark, int pos)
 	return pos;
 }
 
+int HtmlParser::goAfter(const QString &text, const char *mark, int pos)
+{
+	return goBefore(text, mark, pos) + qstrlen(mark);
+}
+
+int HtmlParser::goBefore(const QString &text, const char *mark, int pos)
+{
+	pos = indexOf(text, mark, pos);
+	if (pos==-1)
+		pos = text.size();
+	return pos;
+}
+
 QString HtmlParser::detach(QString &str, const QString &pattern)
 {
-	QRegExp reg("^.*"+pattern);
-	reg.setMinimal(true);
+	QRegExp reg = detachExp(pattern);
 	reg.indexIn(str);
 	QString result = reg.cap(0);
 	str.remove(0,result.size());
 	return result;
 }
 
-QStringList& HtmlParser::getUnderlined(QString text)
+int HtmlParser::findAfter(const QString &text, const char *mark, int pos, int end)
 {
-	int pos = 0;
-	int pos1 = 0;
-	int pos2 = 0;
-	QStringList *result = new QStringList;
-	QString str = QString(text);
-	
-	// two types of underlined text
-	QRegExp u1 = QRegExp("<u>.*(?=</u>)", Qt::CaseInsensitive);
-	QRegExp u2 = QRegExp("<span[^>]*text-decoration:underline[^>]*>.*(?=</span>)", Qt::CaseInsensitive);
-	u1.setMinimal(true);
-	u2.setMinimal(true);
+	int i = indexOfMark(text.constData(), qMin(end, text.size()), mark, pos);
+	return i == -1 ? -1 : i + qstrlen(mark);
+}
+
+int HtmlParser::findAfter(const QByteArray &text, const char *mark, int pos, int end)
+{
+	int i = indexOfMark(text.constData(), qMin(end, text.size()), mark, pos);
+	return i == -1 ? -1 : i + qstrlen(mark);
+}
+
+// ------------------- underline scanner ---------------------
+
+// The scanner is written once for both UTF-16 (QChar) and UTF-8 (char) input.
+// All the markup it looks for is ASCII, so UTF-8 can be scanned byte by byte
+// and only the collected words have to be decoded.
+
+namespace
+{
+	// kinds of tags the underline scanner distinguishes
+	enum TagKind { OtherTag, UOpen, UClose, SpanOpen, UnderlineSpanOpen, SpanClose };
+
+	// what kind of underline the scanner is in
+	enum UnderlineMode { NoUnderline, UTag, SpanTag };
+
+	inline bool isSpace(QChar c)	{ return c.isSpace(); }
+	inline bool isSpace(char c)		{ return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
+
+	// words are collected in the encoding of the input and decoded once when complete
+	inline void appendChars(QString &word, const QChar *p, int n)		{ word += QString::fromRawData(p, n); }
+	inline void appendChars(QByteArray &word, const char *p, int n)	{ word.append(p, n); }
 	
-	// to the moment when nothing left
-	while (pos != -1)
+	// carriage returns of CRLF documents are dropped, as reading them in the text mode did
+	template <typename Buffer, typename Char>
+	void appendRun(Buffer &word, const Char *p, int n)
+	{
+		const Char *end = p + n;
+		while (p != end)
+		{
+			const Char *cr = p;
+			while (cr != end && code(*cr) != '\r')
+				++cr;
+			appendChars(word, p, cr - p);
+			p = (cr == end) ? end : cr + 1;
+		}
+	}
+
+	inline QString toWord(const QString &word)		{ return word; }
+	inline QString toWord(const QByteArray &word)	{ return QString::fromUtf8(word.constData(), word.size()); }
+
+	inline ushort lowerAscii(ushort c)
+	{
+		return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+	}
+
+	// checks whether lower-case 'mark' starts at 'p', ignoring case
+	template <typename Char>
+	bool matchAt(const Char *p, const Char *end, const char *mark)
 	{
-		QString cap;
+		for (; *mark; ++p, ++mark)
+			if (p == end || lowerAscii(code(*p)) != (uchar)*mark)
+				return false;
+		return true;
+	}
+
+	// checks whether lower-case 'mark' occurs anywhere in [p, end), ignoring case
+	template <typename Char>
+	bool containsMark(const Char *p, const Char *end, const char *mark)
+	{
+		for (; p != end; ++p)
+			if (matchAt(p, end, mark))
+				return true;
+		return false;
+	}
+
+	// 'p' points at '<'; classifies the tag and returns position after its '>',
+	// or 0 if the tag is not closed before 'end'
+	template <typename Char>
+	const Char *scanTag(const Char *p, const Char *end, TagKind &kind)
+	{
+		kind = OtherTag;
+		
+		// comments may contain '>' so they end only at "-->"
+		if (matchAt(p, end, "<!--"))
+		{
+			for (p += 4; p != end; ++p)
+				if (matchAt(p, end, "-->"))
+					return p + 3;
+			return 0;
+		}
 		
-		//  if given pattern was found in the last cycle -> find next
-		if (pos1 != -1)
-			pos1 = u1.indexIn(str, pos);
-		if (pos2 != -1)
-			pos2 = u2.indexIn(str, pos);
+		const Char *q = p + 1;
+		bool closing = (q != end && code(*q) == '/');
+		if (closing)
+			++q;
 		
-		// found word is the nearer one
-		if (pos1 != -1 && ((pos2 != -1 && pos1 < pos2) || pos2 == -1))
+		const Char *name = q;
+		while (q != end && code(*q) != '>' && code(*q) != '/' && !isSpace(*q))
+			++q;
+		int nameLength = q - name;
+		
+		const Char *attributes = q;
+		while (q != end && code(*q) != '>')
+			++q;
+		
+		if (nameLength == 1 && lowerAscii(code(*name)) == 'u')
+			kind = closing ? UClose : UOpen;
+		else if (nameLength == 4 && matchAt(name, end, "span"))
 		{
-			pos = pos1+u1.matchedLength();
-			cap = u1.cap();
+			if (closing)
+				kind = SpanClose;
+			else if (containsMark(attributes, q, "text-decoration:underline"))
+				kind = UnderlineSpanOpen;
+			else
+				kind = SpanOpen;
 		}
-		else if (pos2 != -1)
+		
+		return q == end ? 0 : q + 1;
+	}
+
+	// single pass over [p, end) continuing the state left by the previous chunk:
+	// text between tags is collected only inside an underline, the tags themselves are dropped;
+	// returns where scanning stopped, which is 'end' unless the chunk ends inside a tag
+	// and it is not the 'last' one
+	template <typename Char, typename Buffer>
+	const Char *scanUnderlined(const Char *p, const Char *end, bool last,
+							   HtmlParser::UnderlineState<Buffer> &state, HtmlParser::UnderlinedList &result)
+	{
+		const Char *begin = p;
+		const Char *textStart = p; // beginning of the current text between tags
+		
+		while (p != end)
 		{
-			pos = pos2+u2.matchedLength();
-			cap = u2.cap();
+			if (code(*p) != '<')
+			{
+				int next = indexOfMark(p, end - p, "<", 0);
+				p = (next == -1) ? end : p + next;
+				continue;
+			}
+			
+			TagKind kind;
+			const Char *next = scanTag(p, end, kind);
+			if (!next)
+			{
+				if (!last)
+					break; // the tag is completed in the next chunk
+				next = end;
+			}
+			
+			if (state.mode != NoUnderline && p != textStart)
+				appendRun(state.word, textStart, p - textStart);
+			int tagOffset = state.offset + (p - begin);
+			p = textStart = next;
+			
+			bool finished = false;
+			if (state.mode == NoUnderline)
+			{
+				if (kind == UOpen)
+					state.mode = UTag;
+				else if (kind == UnderlineSpanOpen)
+				{
+					state.mode = SpanTag;
+					state.spanDepth = 1;
+				}
+				state.start = tagOffset;
+			}
+			else if (state.mode == UTag)
+				finished = (kind == UClose);
+			else if (kind == SpanOpen || kind == UnderlineSpanOpen)
+				state.spanDepth++;
+			else if (kind == SpanClose)
+				finished = (--state.spanDepth == 0);
+			
+			if (finished)
+			{
+				if (!state.word.isEmpty())
+				{
+					int length = state.offset + (p - begin) - state.start;
+					result.append(HtmlParser::Underlined(state.start, length, toWord(state.word)));
+				}
+				state.word.clear();
+				state.mode = NoUnderline;
+			}
 		}
-		else // broken if pos1 == 1 && pos2 == 1
-			break;
 		
-		// add to the list after removing html tags
-		result->append(cap.remove(QRegExp("<[^>]*>", Qt::CaseInsensitive)));
+		// text running over the end of the chunk
+		if (state.mode != NoUnderline && p != textStart)
+			appendRun(state.word, textStart, p - textStart);
+		
+		state.offset += p - begin;
+		return p;
 	}
-	result->removeDuplicates();
-	//result->sort();
-	return *result;
+	
+	// appends words from 'from' which are not in 'found' yet to 'to'
+	void appendNew(const HtmlParser::UnderlinedList &from, HtmlParser::UnderlinedList &to, QSet<QString> &found)
+	{
+		foreach (const HtmlParser::Underlined &u, from)
+		{
+			if (!found.contains(u.text))
+			{
+				found.insert(u.text);
+				to.append(u);
+			}
+		}
+	}
+}
+
+QStringList HtmlParser::wordList(const UnderlinedList &list)
+{
+	QStringList words;
+	words.reserve(list.size());
+	foreach (const Underlined &u, list)
+		words.append(u.text);
+	return words;
+}
+
+HtmlParser::UnderlineScanner::UnderlineScanner()
+{
+	reset();
+}
+
+void HtmlParser::UnderlineScanner::reset()
+{
+	state = UnderlineState<QByteArray>();
+	found.clear();
+}
+
+int HtmlParser::UnderlineScanner::feed(const char *data, int size, UnderlinedList &words, bool last)
+{
+	UnderlinedList chunkWords;
+	const char *stop = scanUnderlined(data, data + size, last, state, chunkWords);
+	appendNew(chunkWords, words, found);
+	return stop - data;
+}
+
+HtmlParser::UnderlinedList HtmlParser::getUnderlined(const QString &text)
+{
+	UnderlinedList all;
+	UnderlineState<QString> state;
+	const QChar *data = text.constData();
+	scanUnderlined(data, data + text.size(), true, state, all);
+	
+	UnderlinedList result;
+	QSet<QString> found;
+	appendNew(all, result, found);
+	return result;
+}
+
+HtmlParser::UnderlinedList HtmlParser::getUnderlined(const char *data, int size)
+{
+	UnderlinedList result;
+	UnderlineScanner scanner;
+	scanner.feed(data, size, result, true);
+	return result;
+}
+
+HtmlParser::UnderlinedList HtmlParser::getUnderlined(QFile &file)
+{
+	// mapping lets the scanner read the page cache directly,
+	// so the document is never copied into the process
+	qint64 size = file.size();
+	uchar *data = size ? file.map(0, size) : 0;
+	if (data)
+	{
+		UnderlinedList result = getUnderlined((const char*)data, (int)size);
+		file.unmap(data);
+		return result;
+	}
+	
+	// some devices can not be mapped
+	QByteArray content = file.readAll();
+	return getUnderlined(content.constData(), content.size());
+}
+
+HtmlParser::UnderlinedList HtmlParser::getUnderlinedFromFile(const QString &fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return UnderlinedList();
+	
+	return getUnderlined(file);
 }
 
 
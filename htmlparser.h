@@ -40,11 +40,79 @@
 #define HTMLPARSER_H
 
 #include <QStringList>
+#include <QFile>
+#include <QSet>
 
 namespace HtmlParser
 {
-	// returns underlined words
-	QStringList& getUnderlined(QString text);
+	// underlined word found in a document
+	struct Underlined
+	{
+		Underlined() : offset(0), length(0) {}
+		Underlined(int offset, int length, const QString &text) : offset(offset), length(length), text(text) {}
+
+		// place of the underline including its tags in the source,
+		// counted in characters of QString or in bytes of UTF-8 data
+		int offset;
+		int length;
+
+		QString text; // the word without tags
+	};
+
+	// implicitly shared, so it is cheap to return by value
+	typedef QList<Underlined> UnderlinedList;
+
+	// returns texts of the underlined words
+	QStringList wordList(const UnderlinedList &list);
+
+	// returns underlined words, each word once in order of the first occurrence
+	// words differing in case only are different (e.g. Essen, essen)
+	UnderlinedList getUnderlined(const QString &text);
+
+	// the same for UTF-8 encoded html, only the found words are decoded
+	UnderlinedList getUnderlined(const char *data, int size);
+
+	// the same for an opened UTF-8 html file, which is memory mapped rather than read
+	UnderlinedList getUnderlined(QFile &file);
+
+	// the same for a file given by name, returns an empty list if it cannot be read
+	// safe to be run concurrently, e.g. by QtConcurrent::mapped
+	UnderlinedList getUnderlinedFromFile(const QString &fileName);
+
+	template <typename Buffer>
+	struct UnderlineState
+		// state of an underline scan carried over between chunks of a document
+	{
+		UnderlineState() : mode(0), spanDepth(0), start(0), offset(0) {}
+
+		int mode;
+		int spanDepth;
+		int start;		// offset of the current underline
+		int offset;		// offset of the next chunk
+		Buffer word;	// unfinished word
+	};
+
+	class UnderlineScanner
+		// finds underlined words in UTF-8 html given in consecutive chunks,
+		// so the words can be used before the whole document is read
+	{
+	public:
+		UnderlineScanner();
+
+		// appends words found in 'data' and not found before to 'words'
+		// offsets are counted from the beginning of the document
+		// returns number of bytes consumed; the rest is an unfinished tag
+		// and has to be passed again at the beginning of the next chunk
+		// 'last' means that the document ends with 'data'
+		int feed(const char *data, int size, UnderlinedList &words, bool last = false);
+
+		// prepares the scanner for a new document
+		void reset();
+
+	private:
+		UnderlineState<QByteArray> state;
+		QSet<QString> found;
+	};
 	
 	// TO DO:
 	// get rid of extract, goBefore, goAfter and substitude by QRegExp where possible
@@ -54,12 +122,24 @@ namespace HtmlParser
 
 	// returns position of the first character in 'text' of 'mark', starts at 'pos'
 	int goBefore(const QString &text, const QString &mark, int pos);
+	int goBefore(const QString &text, const char *mark, int pos);
 
 	// returns position of the next character in 'text' after 'mark', starts at 'pos'
 	int goAfter(const QString &text, const QString &mark, int pos);
+	int goAfter(const QString &text, const char *mark, int pos);
+
+	// fast case sensitive search of a short ASCII 'mark' (like html tags) starting at 'from'
+	// returns -1 if not found; uses SSE2 if the compiler targets it
+	int indexOf(const QString &text, const char *mark, int from = 0);
+	int indexOf(const QByteArray &text, const char *mark, int from = 0);
 	
 	// detaches and returns the beginning of string 'str' including 'pattern'
 	QString detach(QString &str, const QString &pattern);
+
+	// non-destructive counterpart of detach() for a plain mark:
+	// returns position just after the first 'mark' between 'pos' and 'end', -1 if there is none
+	int findAfter(const QString &text, const char *mark, int pos, int end);
+	int findAfter(const QByteArray &text, const char *mark, int pos, int end);
 }
 
 #endif // HTMLPARSER_H
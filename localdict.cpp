@@ -0,0 +1,347 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "localdict.h"
+
+#include <QDesktopServices>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QtConcurrentRun>
+
+#include <string.h>
+
+namespace
+{
+	// index file: header, sorted offsets of records, records
+	// a record is a line of the list prefixed with its headword in lower case: "key <tab> line \n"
+	const char indexMagic[4] = {'T', 'R', 'L', 'D'};
+	const quint32 indexVersion = 1;
+	
+	struct IndexHeader
+	{
+		char magic[4];
+		quint32 version;
+		quint32 count;
+	};
+	
+	typedef QPair<QByteArray, QByteArray> Record; // key, line
+	
+	bool lessKey(const Record &a, const Record &b)
+	{
+		return a.first < b.first;
+	}
+	
+	QByteArray headwordKey(const QString &word)
+	{
+		return word.trimmed().toLower().toUtf8();
+	}
+	
+	WordClass wordClass(const QString &s)
+	{
+		QString c = s.trimmed().toLower();
+		if (c == "noun" || c == "n")
+			return NOUN;
+		else if (c == "verb" || c == "v")
+			return VERB;
+		else if (c == "adj")
+			return ADJ;
+		else if (c == "adv")
+			return ADV;
+		else if (c == "pron")
+			return PRON;
+		else if (c == "conj")
+			return CONJ;
+		return WNA;
+	}
+	
+	Gender gender(const QString &s)
+	{
+		QString g = s.trimmed().toLower();
+		if (g == "m")
+			return M;
+		else if (g == "f")
+			return F;
+		else if (g == "n" || g == "nt")
+			return N;
+		return GNA;
+	}
+}
+
+LocalDict::LocalDict(TreeModel *model, QObject *parent) : WebDict(model, parent)
+{
+	name = "Local";
+	website = QUrl::fromLocalFile(getDirectory());
+	addLanguage("PL");
+	addLanguage("EN");
+	addLanguage("DE");
+	addLanguage("FR");
+	
+	map = 0;
+	mapSize = 0;
+	count = 0;
+	offsets = 0;
+	
+	connect(&importWatcher, SIGNAL(finished()), this, SLOT(importFinished()));
+}
+
+LocalDict::~LocalDict()
+{
+	waitForParsers();
+	closeIndex();
+}
+
+QString LocalDict::getDirectory()
+{
+	return QDesktopServices::storageLocation(QDesktopServices::DataLocation) + "/dictionaries";
+}
+
+bool LocalDict::import(const QString &listFile, const QString &indexFile)
+{
+	QFile list(listFile);
+	if (!list.open(QIODevice::ReadOnly))
+		return 0;
+	
+	QList<Record> records;
+	while (!list.atEnd())
+	{
+		QByteArray line = list.readLine().trimmed();
+		int tab = line.indexOf('\t');
+		if (tab <= 0 || line.startsWith('#'))
+			continue;
+		records.append(Record(headwordKey(QString::fromUtf8(line.constData(), tab)), line));
+	}
+	// entries of a headword stay in the order of the list
+	qStableSort(records.begin(), records.end(), lessKey);
+	
+	IndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, indexMagic, sizeof(indexMagic));
+	header.version = indexVersion;
+	header.count = records.size();
+	
+	QByteArray data;
+	QVector<quint32> recordOffsets;
+	recordOffsets.reserve(records.size());
+	quint32 base = sizeof(header) + records.size() * sizeof(quint32);
+	foreach (const Record &r, records)
+	{
+		recordOffsets.append(base + data.size());
+		data.append(r.first);
+		data.append('\t');
+		data.append(r.second);
+		data.append('\n');
+	}
+	
+	// written aside, so a running instance never maps half of an index
+	QString temp = indexFile + ".tmp";
+	QFile out(temp);
+	if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return 0;
+	bool ok = out.write((const char*)&header, sizeof(header)) == sizeof(header)
+		&& out.write((const char*)recordOffsets.constData(), recordOffsets.size() * sizeof(quint32))
+			== qint64(recordOffsets.size() * sizeof(quint32))
+		&& out.write(data) == data.size();
+	out.close();
+	
+	QFile::remove(indexFile);
+	if (!ok || !QFile::rename(temp, indexFile))
+	{
+		QFile::remove(temp);
+		return 0;
+	}
+	return 1;
+}
+
+void LocalDict::closeIndex()
+{
+	if (map)
+		index.unmap((uchar*)map);
+	index.close();
+	map = 0;
+	mapSize = 0;
+	count = 0;
+	offsets = 0;
+	indexLang.clear();
+}
+
+bool LocalDict::ready()
+{
+	// runs in the main thread, like all WebDict scheduling
+	if (importWatcher.isRunning())
+		return 0;
+	
+	QString lang = sourceLang + "-" + targetLang;
+	if (lang == indexLang)
+		return 1;
+	closeIndex();
+	
+	QDir dir(getDirectory());
+	QFileInfo list(dir.filePath(lang + ".tsv"));
+	QFileInfo indexInfo(dir.filePath(lang + ".idx"));
+	
+	// a bulk list takes a while to read and sort, so the user interface is not blocked by it
+	if (list.exists() && (!indexInfo.exists() || indexInfo.lastModified() < list.lastModified()))
+	{
+		importLang = lang;
+		importWatcher.setFuture(QtConcurrent::run(&LocalDict::import, list.filePath(), indexInfo.filePath()));
+		return 0;
+	}
+	
+	openIndex(lang);
+	return 1;
+}
+
+void LocalDict::importFinished()
+{
+	// the index is opened even if the import failed, so it is not tried again for every word
+	openIndex(importLang);
+	startDownloads();
+	checkCompleted();
+}
+
+void LocalDict::openIndex(const QString &lang)
+{
+	closeIndex();
+	
+	index.setFileName(QDir(getDirectory()).filePath(lang + ".idx"));
+	indexLang = lang; // not to try again for every word if there is no index
+	if (!index.open(QIODevice::ReadOnly))
+		return;
+	
+	mapSize = index.size();
+	map = mapSize >= (qint64)sizeof(IndexHeader) ? index.map(0, mapSize) : 0;
+	if (!map)
+		return;
+	
+	IndexHeader header;
+	memcpy(&header, map, sizeof(header));
+	if (memcmp(header.magic, indexMagic, sizeof(indexMagic)) || header.version != indexVersion
+		|| sizeof(header) + (qint64)header.count * sizeof(quint32) > mapSize)
+	{
+		QString keep = indexLang;
+		closeIndex();
+		indexLang = keep;
+		return;
+	}
+	count = header.count;
+	offsets = (const quint32*)(map + sizeof(header));
+}
+
+bool LocalDict::matches(quint32 pos, const QByteArray &key) const
+{
+	quint32 offset = offsets[pos];
+	return offset + key.size() < mapSize && !memcmp(map + offset, key.constData(), key.size())
+		&& map[offset + key.size()] == '\t';
+}
+
+bool LocalDict::lookup(const QString &word, QByteArray &page)
+{
+	// called only when ready(), so the index is mapped if there is one
+	page = QByteArray("");
+	if (!map)
+		return 1;
+	
+	QByteArray key = headwordKey(word);
+	
+	// the first record not less than the key, records compare by their keys
+	quint32 first = 0, last = count;
+	while (first < last)
+	{
+		quint32 middle = first + (last - first) / 2;
+		quint32 offset = offsets[middle];
+		const uchar *record = map + offset;
+		const uchar *tab = (const uchar*)memchr(record, '\t', mapSize - offset);
+		int size = tab ? tab - record : mapSize - offset;
+		
+		int c = memcmp(record, key.constData(), qMin(size, key.size()));
+		if (c < 0 || (c == 0 && size < key.size()))
+			first = middle + 1;
+		else
+			last = middle;
+	}
+	
+	// lines of all entries of the headword, without keys
+	for (; first < count && matches(first, key); first++)
+	{
+		const char *line = (const char*)map + offsets[first] + key.size() + 1;
+		const char *end = (const char*)memchr(line, '\n', (const char*)map + mapSize - line);
+		page.append(line, end ? end - line + 1 : (const char*)map + mapSize - line);
+	}
+	return 1;
+}
+
+QNetworkReply *LocalDict::query(const QString &word)
+{
+	// every word is answered by lookup()
+	Q_UNUSED(word);
+	return 0;
+}
+
+void LocalDict::parse(const QByteArray &data, TreeItem *root)
+{
+	// entries with the same word class, gender and plural are put under one speech part
+	TreeItem *parent = root;
+	WordClass lastClass = WNA;
+	Gender lastGender = GNA;
+	QString lastPlural;
+	
+	foreach (const QByteArray &line, data.split('\n'))
+	{
+		QStringList fields = QString::fromUtf8(line).split('\t');
+		if (fields.size() < 2)
+			continue;
+		
+		QString source = fields.at(0).trimmed();
+		QString target = fields.at(1).trimmed();
+		WordClass c = fields.size() > 2 ? wordClass(fields.at(2)) : WNA;
+		Gender g = fields.size() > 3 ? gender(fields.at(3)) : GNA;
+		QString plural = fields.size() > 4 ? fields.at(4).trimmed() : QString();
+		
+		if (parent == root || c != lastClass || g != lastGender || plural != lastPlural)
+		{
+			parent = c ? root->addStdWord("", SPEECHPART, plural, c, g) : root;
+			lastClass = c;
+			lastGender = g;
+			lastPlural = plural;
+		}
+		
+		parent->addStdWord(source, STD)->addTargetWord(target, targetLangId);
+	}
+}
@@ -0,0 +1,99 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOCALDICT_H
+#define LOCALDICT_H
+
+#include "webdict.h"
+
+#include <QFile>
+#include <QFutureWatcher>
+
+// offline dictionary made of bilingual word lists
+
+class LocalDict : public WebDict
+	// word lists are tab separated text files (UTF-8) named <source>-<target>.tsv, e.g. "de-pl.tsv"
+	// and put in the directory given by getDirectory(), one entry per line:
+	// headword <tab> translation [<tab> word class [<tab> gender [<tab> plural]]]
+	// e.g. "Haus	dom	noun	n	Häuser"
+	// a list is imported once into a sorted index file next to it, which is memory mapped and searched binary
+	// the import runs in a worker thread, words wait for it in the queue
+{
+	Q_OBJECT
+public:
+	LocalDict(TreeModel *model, QObject *parent = 0);
+	~LocalDict();
+	
+	void parse(const QByteArray &data, TreeItem *root);
+	
+	static QString getDirectory();
+	
+	// builds the index of a word list; returns false if the list can not be read or the index written
+	static bool import(const QString &listFile, const QString &indexFile);
+	
+protected:
+	bool lookup(const QString &word, QByteArray &page);
+	bool usesNetworkCache() const { return 0; }
+	
+	// maps the index for the current languages; if the list is newer, starts its import and returns false
+	bool ready();
+	
+private slots:
+	void importFinished();
+	
+private:
+	QNetworkReply *query(const QString &word);
+	
+	// maps the index of languages 'lang', e.g. "de-pl"
+	void openIndex(const QString &lang);
+	void closeIndex();
+	
+	// entries of the index with the headword 'key', at 'pos' or after it
+	bool matches(quint32 pos, const QByteArray &key) const;
+	
+	QFile index;
+	QString indexLang; // languages of the opened index
+	QFutureWatcher<bool> importWatcher;
+	QString importLang; // languages of the list being imported
+	const uchar *map;
+	qint64 mapSize;
+	quint32 count;
+	const quint32 *offsets;
+};
+
+#endif // LOCALDICT_H
@@ -0,0 +1,372 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "lookupstore.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QVector>
+#include <QtAlgorithms>
+
+#include <string.h>
+
+namespace
+{
+	const char storeMagic[4] = {'T', 'R', 'L', 'S'};
+	const quint32 storeVersion = 2;
+	const quint32 storeSlots = 1 << 17; // 1 MB of slots
+	
+	// record: key size, value size, time of storing (seconds since the epoch), key, value
+	const int recordHeaderSize = 3 * sizeof(quint32);
+	
+	// a record to be kept by compaction
+	struct Kept
+	{
+		quint32 offset;
+		quint32 time;
+		quint32 size;
+	};
+	
+	bool newer(const Kept &a, const Kept &b)
+	{
+		return a.time > b.time;
+	}
+	
+	QString semaphoreKey(const QString &fileName)
+	{
+		QByteArray path = QFileInfo(fileName).absoluteFilePath().toUtf8();
+		return "translator-store-" + QCryptographicHash::hash(path, QCryptographicHash::Sha1).toHex();
+	}
+}
+
+LookupStore::LookupStore(const QString &fileName, int timeToLive) :
+	file(fileName), semaphore(semaphoreKey(fileName), 1, QSystemSemaphore::Open), timeToLive(timeToLive), map(0), mapSize(0)
+{
+	QDir().mkpath(QFileInfo(fileName).absolutePath());
+	
+	// two instances started at once must not both create the table
+	semaphore.acquire();
+	bool ok = file.open(QIODevice::ReadWrite) && init();
+	semaphore.release();
+	
+	if (!ok)
+		file.close();
+}
+
+LookupStore::~LookupStore()
+{
+	if (map)
+		file.unmap(map);
+}
+
+bool LookupStore::create(QFile &file)
+{
+	Header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, storeMagic, sizeof(storeMagic));
+	h.version = storeVersion;
+	h.slotsNum = storeSlots;
+	
+	// the table is filled with zeros, i.e. empty slots
+	return file.resize(0) && file.resize(headerSize + storeSlots * sizeof(Slot)) && file.seek(0)
+		&& file.write((const char*)&h, sizeof(h)) == sizeof(h) && file.flush();
+}
+
+bool LookupStore::init()
+{
+	if (!file.size() && !create(file))
+		return 0;
+	
+	if (!remap())
+		return 0;
+	
+	// the store is only a cache, a file of an older version is started again
+	if (mapSize >= (qint64)sizeof(Header) && !memcmp(header()->magic, storeMagic, sizeof(storeMagic))
+		&& header()->version != storeVersion)
+	{
+		file.unmap(map);
+		map = 0;
+		if (!create(file) || !remap())
+			return 0;
+	}
+	
+	const Header *h = header();
+	if (mapSize < headerSize || memcmp(h->magic, storeMagic, sizeof(storeMagic)) || h->version != storeVersion
+		|| !h->slotsNum || (h->slotsNum & (h->slotsNum - 1))
+		|| mapSize < headerSize + (qint64)h->slotsNum * (qint64)sizeof(Slot))
+	{
+		file.unmap(map);
+		map = 0;
+		return 0;
+	}
+	return 1;
+}
+
+void LookupStore::reopen()
+{
+	if (map)
+		file.unmap(map);
+	map = 0;
+	file.close();
+	if (!file.open(QIODevice::ReadWrite) || !init())
+		file.close();
+}
+
+quint32 LookupStore::now()
+{
+	return QDateTime::currentDateTime().toTime_t();
+}
+
+bool LookupStore::fresh(const uchar *record) const
+{
+	quint32 time;
+	memcpy(&time, record + 2 * sizeof(quint32), sizeof(time));
+	return (qint64)time + timeToLive >= now();
+}
+
+bool LookupStore::remap()
+{
+	if (map)
+		file.unmap(map);
+	mapSize = file.size();
+	map = file.map(0, mapSize);
+	return map != 0;
+}
+
+QByteArray LookupStore::key(const QString &word, const QString &sourceLang, const QString &targetLang)
+{
+	return (word + '\t' + sourceLang.toLower() + '\t' + targetLang.toLower()).toUtf8();
+}
+
+quint32 LookupStore::hash(const QByteArray &key)
+{
+	// FNV-1a, the same in every process and Qt version
+	quint32 h = 2166136261u;
+	for (int i = 0; i < key.size(); i++)
+	{
+		h ^= (uchar)key.at(i);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+LookupStore::Slot *LookupStore::probe(const QByteArray &key, quint32 hash, bool *found)
+{
+	*found = 0;
+	quint32 mask = header()->slotsNum - 1;
+	
+	for (quint32 n = 0, i = hash & mask; n <= mask; n++, i = (i + 1) & mask)
+	{
+		Slot *slot = slotTable() + i;
+		quint32 offset = slot->offset;
+		if (!offset)
+			return slot;
+		if (slot->hash != hash)
+			continue;
+		
+		// the record may have been appended by another process after the file was mapped
+		if (offset + recordHeaderSize > mapSize)
+		{
+			if (!remap() || offset + recordHeaderSize > mapSize)
+				return 0;
+			slot = slotTable() + i;
+		}
+		quint32 sizes[2];
+		memcpy(sizes, map + offset, sizeof(sizes));
+		if ((qint64)offset + recordHeaderSize + sizes[0] + sizes[1] > mapSize)
+		{
+			if (!remap() || (qint64)offset + recordHeaderSize + sizes[0] + sizes[1] > mapSize)
+				return 0;
+			slot = slotTable() + i;
+		}
+		
+		if (sizes[0] == (quint32)key.size() && !memcmp(map + offset + recordHeaderSize, key.constData(), key.size()))
+		{
+			*found = 1;
+			return slot;
+		}
+	}
+	return 0;
+}
+
+QByteArray LookupStore::find(const QByteArray &key)
+{
+	if (map && header()->retired)
+	{
+		semaphore.acquire();
+		reopen();
+		semaphore.release();
+	}
+	if (!map)
+		return QByteArray();
+	
+	bool found;
+	Slot *slot = probe(key, hash(key), &found);
+	if (!found || !fresh(map + slot->offset))
+		return QByteArray();
+	
+	const uchar *record = map + slot->offset;
+	quint32 sizes[2];
+	memcpy(sizes, record, sizeof(sizes));
+	return QByteArray((const char*)record + recordHeaderSize + sizes[0], sizes[1]);
+}
+
+bool LookupStore::insert(const QByteArray &key, const QByteArray &value)
+{
+	if (!map)
+		return 0;
+	
+	quint32 h = hash(key);
+	bool result = 0;
+	
+	semaphore.acquire();
+	
+	if (header()->retired)
+		reopen();
+	
+	bool found = 0;
+	Slot *slot = 0;
+	qint64 offset = 0;
+	// keep a quarter of slots empty, so probing stays short; offsets are 32 bit
+	for (int attempt = 0; map && attempt < 2; attempt++)
+	{
+		slot = probe(key, h, &found);
+		offset = file.size();
+		qint64 end = offset + recordHeaderSize + key.size() + value.size();
+		if (slot && (found || header()->used < header()->slotsNum / 4 * 3) && end <= 0xffffffffLL)
+			break;
+		slot = 0;
+		if (attempt || !compact())
+			break;
+	}
+	
+	if (slot)
+	{
+		quint32 fields[3] = {(quint32)key.size(), (quint32)value.size(), now()};
+		if (file.seek(offset) && file.write((const char*)fields, sizeof(fields)) == sizeof(fields)
+			&& file.write(key) == key.size() && file.write(value) == value.size() && file.flush())
+		{
+			// the record is complete before it is visible to readers
+			// a replaced record stays in the file until the next compaction
+			slot->hash = h;
+			slot->offset = (quint32)offset;
+			if (!found)
+				header()->used++;
+			result = 1;
+		}
+	}
+	else if (map)
+		qWarning("LookupStore: %s is full", qPrintable(file.fileName()));
+	
+	semaphore.release();
+	return result;
+}
+
+bool LookupStore::compact()
+{
+	// all records appended by other processes are seen
+	if (!remap())
+		return 0;
+	
+	// fresh records, the newest of them if they would fill more than half of the new table
+	QVector<Kept> kept;
+	const Slot *current = slotTable();
+	for (quint32 i = 0; i < header()->slotsNum; i++)
+	{
+		quint32 offset = current[i].offset;
+		if (!offset || (qint64)offset + recordHeaderSize > mapSize)
+			continue;
+		quint32 fields[3];
+		memcpy(fields, map + offset, sizeof(fields));
+		Kept k = { offset, fields[2], recordHeaderSize + fields[0] + fields[1] };
+		if ((qint64)offset + k.size <= mapSize && fresh(map + offset))
+			kept.append(k);
+	}
+	qSort(kept.begin(), kept.end(), newer);
+	kept.resize(qMin(kept.size(), (int)(storeSlots / 2)));
+	
+	QString fileName = file.fileName();
+	QFile out(fileName + ".new");
+	if (!out.open(QIODevice::ReadWrite) || !create(out))
+		return 0;
+	
+	QVector<Slot> table(storeSlots);
+	memset(table.data(), 0, table.size() * sizeof(Slot));
+	quint32 mask = storeSlots - 1;
+	qint64 end = out.size();
+	bool ok = out.seek(end);
+	for (int i = 0; ok && i < kept.size(); i++)
+	{
+		const uchar *record = map + kept[i].offset;
+		quint32 keySize;
+		memcpy(&keySize, record, sizeof(keySize));
+		quint32 h = hash(QByteArray::fromRawData((const char*)record + recordHeaderSize, keySize));
+		
+		quint32 j = h & mask;
+		while (table[j].offset)
+			j = (j + 1) & mask;
+		table[j].hash = h;
+		table[j].offset = (quint32)end;
+		
+		ok = out.write((const char*)record, kept[i].size) == kept[i].size;
+		end += kept[i].size;
+	}
+	
+	Header h;
+	memcpy(&h, header(), sizeof(h));
+	h.slotsNum = storeSlots;
+	h.used = kept.size();
+	h.retired = 0;
+	ok = ok && out.seek(0) && out.write((const char*)&h, sizeof(h)) == sizeof(h)
+		&& out.seek(headerSize) && out.write((const char*)table.constData(), table.size() * sizeof(Slot)) == table.size() * (qint64)sizeof(Slot)
+		&& out.flush();
+	out.close();
+	
+	// processes having the old file mapped keep reading it until they see 'retired'
+	// (a mapped file can not be removed on Windows, the store stays full there)
+	if (!ok || !QFile::remove(fileName) || !QFile::rename(out.fileName(), fileName))
+	{
+		QFile::remove(out.fileName());
+		return 0;
+	}
+	header()->retired = 1;
+	reopen();
+	return map != 0;
+}
@@ -0,0 +1,114 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef LOOKUPSTORE_H
+#define LOOKUPSTORE_H
+
+#include <QFile>
+#include <QSystemSemaphore>
+
+class LookupStore
+	// pages of a dictionary kept between runs and shared by all running instances of the program
+	// a hash table with open addressing in a memory mapped file, records are appended to the end of the file
+	// so nothing is loaded at start and a lookup reads only a slot and a record from the page cache
+	// readers do not lock, writers of all processes are serialized by a system semaphore
+	// records older than 'timeToLive' seconds are not found, so pages are downloaded again (or revalidated)
+	// when the table fills up, fresh records are copied into a new file, which all processes switch to
+	// an object must be used by one thread
+{
+public:
+	explicit LookupStore(const QString &fileName, int timeToLive = 7 * 24 * 3600);
+	~LookupStore();
+	
+	bool isOpen() const { return map != 0; }
+	
+	static QByteArray key(const QString &word, const QString &sourceLang, const QString &targetLang);
+	
+	// returns a null array if there is no such key or its record is too old
+	QByteArray find(const QByteArray &key);
+	// a value stored before under the same key is replaced
+	// returns false if the store is not open or full even after compaction
+	bool insert(const QByteArray &key, const QByteArray &value);
+	
+private:
+	struct Header
+	{
+		char magic[4];
+		quint32 version;
+		quint32 slotsNum; // power of 2
+		quint32 used;
+		quint32 retired; // the file was replaced by a compacted one, which has to be opened
+	};
+	
+	struct Slot
+	{
+		quint32 hash;
+		quint32 offset; // of the record, 0 if the slot is empty; written last
+	};
+	
+	// maps the whole file again, after other processes appended records
+	bool remap();
+	// checks the header or writes a new empty table into an empty file or a file of an older version
+	bool init();
+	static bool create(QFile &file);
+	// opens the file again after another process has compacted it, the semaphore must be held
+	void reopen();
+	// copies the freshest records into a new file which replaces the current one, the semaphore must be held
+	bool compact();
+	
+	static quint32 now();
+	bool fresh(const uchar *record) const;
+	
+	Header *header() const { return (Header*)map; }
+	Slot *slotTable() const { return (Slot*)(map + headerSize); }
+	
+	// the slot holding 'key' or the empty slot where it should be put; 0 if the table is full
+	Slot *probe(const QByteArray &key, quint32 hash, bool *found);
+	
+	static quint32 hash(const QByteArray &key);
+	
+	static const int headerSize = 64;
+	
+	QFile file;
+	QSystemSemaphore semaphore;
+	int timeToLive;
+	uchar *map;
+	qint64 mapSize;
+};
+
+#endif // LOOKUPSTORE_H
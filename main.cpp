@@ -42,6 +42,8 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    // names the directory of the http cache
+    a.setApplicationName("translator");
     MainWindow w;
     w.show();
 
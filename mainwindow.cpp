@@ -40,6 +40,7 @@
 #include "ui_mainwindow.h"
 
 #include "pons.h"
+#include "localdict.h"
 #include "translatechooser.h"
 
 #include <QStringList>
@@ -48,11 +49,17 @@
 #include <QTextCodec>
 #include <QDate>
 #include <QDir>
+#include <QTimer>
+#include <QtConcurrentMap>
 
+// bytes of the document scanned at once
+static const int documentChunkSize = 64 * 1024;
 
 MainWindow::MainWindow(QWidget *parent) :
 	QMainWindow(parent),
-	ui(new Ui::MainWindow)
+	ui(new Ui::MainWindow),
+	dict(0),
+	documentData(0)
 {
 	ui->setupUi(this);
 	QTextCodec::setCodecForTr(QTextCodec::codecForName("UTF-8"));
@@ -60,6 +67,7 @@ MainWindow::MainWindow(QWidget *parent) :
 	
 	transTree = new TreeModel(this);
 	dictList.append(new Pons(transTree, this));
+	dictList.append(new LocalDict(transTree, this));
 	
 	baseWindowTitle = windowTitle();
 	
@@ -76,13 +84,11 @@ MainWindow::MainWindow(QWidget *parent) :
 	on_dict_currentIndexChanged(ui->dict->currentIndex());
 	
 	connect(ui->translator, SIGNAL(addResult(QString, QString)), this, SLOT(addResult(QString, QString)));
-	connect(this, SIGNAL(addWords(QStringList)), dict, SLOT(addWords(QStringList)));
-	connect(this, SIGNAL(translateAll()), dict, SLOT(translateAll()));
-	connect(dict, SIGNAL(completed()), this, SLOT(inputModelCompleted()));
 	connect(ui->translator, SIGNAL(wordChanged(QString)), this, SLOT(wordChanged(QString)));
 	connect(ui->wordLineEdit, SIGNAL(addWord()), this, SLOT(on_addWordButton_clicked()));
-	connect(this, SIGNAL(translate(QModelIndex)), dict, SLOT(translate(QModelIndex)));
-	connect(dict, SIGNAL(parse_signal(QByteArray,QModelIndex)), this, SLOT(parse_slot(QByteArray,QModelIndex)));
+	
+	batchWatcher = new QFutureWatcher<HtmlParser::UnderlinedList>(this);
+	connect(batchWatcher, SIGNAL(finished()), this, SLOT(batchScanned()));
 }
 
 MainWindow::~MainWindow()
@@ -90,11 +96,6 @@ MainWindow::~MainWindow()
 	delete ui;
 }
 
-void MainWindow::parse_slot(const QByteArray &data, const QModelIndex &index)
-{
-	dict->parse(data, index);
-}
-
 void MainWindow::inputModelCompleted()
 {
 	if (!ui->translator->model())
@@ -112,43 +113,179 @@ void MainWindow::inputModelCompleted()
 
 void MainWindow::on_dict_currentIndexChanged(int index)
 {
+	if (index < 0)
+		return;
+	
 	ui->sourceLanguage->clear();
 	ui->sourceLanguage->addItems(dictList.at(index)->getLanguages());
 	ui->sourceLanguage->setCurrentIndex(2); // default source language -> EN
 	ui->targetLanguage->clear();
 	ui->targetLanguage->addItems(dictList.at(index)->getLanguages());
-	//disconnect(this, SIGNAL(translate(QStringList, QString)), 0, 0);
+	
+	// only the current dictionary translates
+	if (dict)
+	{
+		disconnect(this, 0, dict, 0);
+		disconnect(dict, 0, this, 0);
+		disconnect(transTree, 0, dict, 0);
+	}
 	dict = dictList.at(index);
-	//connect(this, SIGNAL(translate(QStringList,QString)), dict, SLOT(getTranslations(QStringList, QString)));
+	connect(this, SIGNAL(addWords(QStringList)), dict, SLOT(addWords(QStringList)));
+	connect(this, SIGNAL(translateAll()), dict, SLOT(translateAll()));
+	connect(this, SIGNAL(translate(QModelIndex)), dict, SLOT(translate(QModelIndex)));
+	connect(transTree, SIGNAL(translate(QModelIndex)), dict, SLOT(translate(QModelIndex)));
+	connect(dict, SIGNAL(completed()), this, SLOT(inputModelCompleted()));
 }
 
 void MainWindow::on_openButton_clicked()
 {
-	fileName = QFileDialog::getOpenFileName(this, tr("Open file"), "..", tr("Html (*.htm *.html)"));
+	QStringList fileNames = QFileDialog::getOpenFileNames(this, tr("Open file"), "..",
+														  tr("Html (*.htm *.html);;Translation session (*.tsn)"));
 	//fileName = "../new-translator/data/deutsch.html";
 	
-	if (fileName.isEmpty())
+	if (fileNames.isEmpty())
 		return;
-	setWindowTitle(baseWindowTitle+" - "+fileName);
+	
+	on_newButton_clicked();
+	
+	if (fileNames.first().endsWith(".tsn", Qt::CaseInsensitive))
+	{
+		openSession(fileNames.first());
+		return;
+	}
 	
 	ui->wordLabel->setText("Loading... please wait");
 	
-	on_newButton_clicked();
+	if (fileNames.size() > 1)
+	{
+		openBatch(fileNames);
+		return;
+	}
 	
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	fileName = fileNames.first();
+	setWindowTitle(baseWindowTitle+" - "+fileName);
+	
+	document.setFileName(fileName);
+	if (!document.open(QIODevice::ReadOnly))
 	{
 		message(tr("File read error"));
 		return;
 	}
 	
-	QByteArray fileContent = file.readAll();
-	QString html = QString().fromUtf8(fileContent);
+	documentSize = document.size();
+	documentData = documentSize ? (const char*)document.map(0, documentSize) : 0;
+	if (!documentData)
+	{
+		// some devices can not be mapped
+		documentContent = document.readAll();
+		documentData = documentContent.constData();
+	}
+	documentPos = 0;
+	documentChunk = documentChunkSize;
+	
+	dict->setLang(ui->sourceLanguage->currentText(), ui->targetLanguage->currentText());
+	readDocumentChunk();
+}
+
+void MainWindow::readDocumentChunk()
+{
+	if (!documentData)
+		return; // closed in the meantime
+	
+	qint64 size = qMin((qint64)documentChunk, documentSize - documentPos);
+	bool last = (documentPos + size == documentSize);
+	
+	HtmlParser::UnderlinedList found;
+	int consumed = scanner.feed(documentData + documentPos, (int)size, found, last);
+	documentPos += consumed;
+	
+	// a tag longer than the chunk
+	documentChunk = consumed ? documentChunkSize : documentChunk * 2;
+	
+	if (!found.isEmpty())
+	{
+		QStringList words = HtmlParser::wordList(found);
+		sourceList += words;
+		emit addWords(words);
+	}
+	
+	if (last)
+		closeDocument();
+	else
+		// let the event loop send the requests before the next chunk
+		QTimer::singleShot(0, this, SLOT(readDocumentChunk()));
+}
+
+void MainWindow::openBatch(const QStringList &fileNames)
+{
+	fileName = fileNames.first();
+	setWindowTitle(baseWindowTitle+" - "+tr("%1 files").arg(fileNames.size()));
+	
+	dict->setLang(ui->sourceLanguage->currentText(), ui->targetLanguage->currentText());
+	
+	// one file per task, QtConcurrent uses all cores
+	batchWatcher->setFuture(QtConcurrent::mapped(fileNames, HtmlParser::getUnderlinedFromFile));
+}
+
+void MainWindow::batchScanned()
+{
+	QFuture<HtmlParser::UnderlinedList> future = batchWatcher->future();
+	if (future.isCanceled())
+		return;
+	
+	// the same word is often underlined on several pages, the first occurrence decides the order
+	QSet<QString> found;
+	QStringList words;
+	for (int i = 0; i < future.resultCount(); i++)
+	{
+		foreach (const HtmlParser::Underlined &u, future.resultAt(i))
+		{
+			if (!found.contains(u.text))
+			{
+				found.insert(u.text);
+				words.append(u.text);
+			}
+		}
+	}
 	
-	sourceList = HtmlParser::getUnderlined(html);
+	sourceList = words;
+	// all pages in one rows insertion, the current dictionary is asked for each word by translate()
+	transTree->addMainWords(words);
+}
+
+void MainWindow::openSession(const QString &fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly) || !transTree->load(&file))
+	{
+		message(tr("File read error"));
+		return;
+	}
+	this->fileName = fileName;
+	setWindowTitle(baseWindowTitle+" - "+fileName);
 	
+	// languages of the session, so that edited words are translated the same way
+	int source = ui->sourceLanguage->findText(transTree->getSourceLang(), Qt::MatchFixedString);
+	int target = ui->targetLanguage->findText(transTree->getTargetLang(), Qt::MatchFixedString);
+	if (source != -1)
+		ui->sourceLanguage->setCurrentIndex(source);
+	if (target != -1)
+		ui->targetLanguage->setCurrentIndex(target);
 	dict->setLang(ui->sourceLanguage->currentText(), ui->targetLanguage->currentText());
-	emit addWords(sourceList);
+	
+	for (int i = 0; i < transTree->rowCount(); i++)
+		sourceList.append(transTree->data(transTree->index(i, 0), TreeItem::WordRole).toString());
+	
+	inputModelCompleted();
+}
+
+void MainWindow::closeDocument()
+{
+	if (document.isOpen())
+		document.close(); // unmaps the file too
+	documentContent.clear();
+	documentData = 0;
+	scanner.reset();
 }
 
 void MainWindow::message(const QString &text)
@@ -171,7 +308,8 @@ void MainWindow::wordChanged(const QString &word)
 
 void MainWindow::on_saveButton_clicked()
 {
-	QFileDialog d(this,tr("Save file"), QDir::homePath(), "Pytacz Master (*.txt);;Text files (*.txt)");
+	QFileDialog d(this,tr("Save file"), QDir::homePath(),
+				  "Pytacz Master (*.txt);;Text files (*.txt);;Translation session (*.tsn)");
 	d.setFileMode(QFileDialog::AnyFile);
 	d.setAcceptMode(QFileDialog::AcceptSave);
 	d.setConfirmOverwrite(true);
@@ -184,6 +322,16 @@ void MainWindow::on_saveButton_clicked()
 			return;
 		QString fileType = d.selectedNameFilter();
 		
+		if (fileType == "Translation session (*.tsn)")
+		{
+			if (!fileName.endsWith(".tsn", Qt::CaseInsensitive))
+				fileName += ".tsn";
+			QFile file(fileName);
+			if (!file.open(QIODevice::WriteOnly) || !transTree->save(&file))
+				message(tr("File write error"));
+			return;
+		}
+		
 		// Open file for write
 		QFile file(fileName);
 		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
@@ -262,6 +410,13 @@ void MainWindow::on_newButton_clicked()
 {
 	setWindowTitle(baseWindowTitle);
 	ui->translateButton->setEnabled(false);
+	closeDocument();
+	sourceList.clear();
+	if (batchWatcher->isRunning())
+	{
+		batchWatcher->cancel();
+		batchWatcher->waitForFinished();
+	}
 	// model reset
 	if (transTree->hasChildren())
 	{
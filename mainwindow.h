@@ -41,6 +41,8 @@
 
 #include <QMainWindow>
 #include <QStringList>
+#include <QFile>
+#include <QFutureWatcher>
 
 #include "webdict.h"
 #include "htmlparser.h"
@@ -71,8 +73,7 @@ public slots:
 	void inputModelCompleted();
 
 private slots:
-	// open file, now only html format of input file
-	// cannot open translation file stored before
+	// open file, html format of input file or a session saved before
 	void on_openButton_clicked();
 
 	// add translation to result model
@@ -88,8 +89,11 @@ private slots:
 	
 	void on_helpButton_clicked();
 
-	// temporary solution to make model modifications in main thread
-	void parse_slot(const QByteArray &data, const QModelIndex &index);
+	// scans the next part of the opened document and sends found words to translate
+	void readDocumentChunk();
+
+	// all documents opened at once have been scanned
+	void batchScanned();
 	
 signals:
 	// translate one item
@@ -119,6 +123,19 @@ private:
 	// words to translate
 	QStringList sourceList;
 
+	// opened document, read in chunks between events
+	// so translation of the first words starts before the end of the file is reached
+	QFile document;
+	const char *documentData;
+	QByteArray documentContent; // used only if the file cannot be mapped
+	qint64 documentSize;
+	qint64 documentPos;
+	int documentChunk;
+	HtmlParser::UnderlineScanner scanner;
+
+	// several documents (e.g. pages of a book) opened at once are scanned in parallel
+	QFutureWatcher<HtmlParser::UnderlinedList> *batchWatcher;
+
 	// result table model
 	ResultModel *results;
 
@@ -131,8 +148,16 @@ private:
 	// message window
 	void message(const QString &text);
 
+	void closeDocument();
+
+	// opens several documents at once, words are merged in order of the files
+	void openBatch(const QStringList &fileNames);
+
 	void saveTxt(QTextStream &out) const;
 
+	// restores translations saved with 'Save...', no dictionary is asked again
+	void openSession(const QString &fileName);
+
 	// save file in Pytacz Master format
 	// it is a program for vocabulary learning
 	// http://pytacz-master.softonic.pl/
@@ -41,7 +41,248 @@
 
 using namespace HtmlParser;
 
+// ------------------- cleanup of responses ---------------------
 
+// prepareText() removes parts of a response which are not used by the parser
+// and decodes entities, all in one pass over UTF-8 data. All the marks are ASCII,
+// so bytes of multibyte characters never match them. Each of the functions below
+// recognizes one removed part at 'p' and returns position after it,
+// or 0 if the part does not start at 'p'.
+
+namespace
+{
+	// returns position after 'mark' if 'p' starts with it, otherwise 0
+	const char *skipMark(const char *p, const char *end, const char *mark, Qt::CaseSensitivity cs = Qt::CaseSensitive)
+	{
+		for (; *mark; ++p, ++mark)
+		{
+			if (p == end)
+				return 0;
+			ushort c = (uchar)*p;
+			if (cs == Qt::CaseInsensitive && c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+			if (c != (uchar)*mark)
+				return 0;
+		}
+		return p;
+	}
+	
+	inline const char *findChar(const char *p, const char *end, char c)
+	{
+		while (p != end && *p != c)
+			++p;
+		return p;
+	}
+	
+	// phonetic transcription, nested spans are allowed inside
+	// <span class='phonetics'>((<span([^<])*</span>)|[^(</)])*</span>
+	const char *phoneticsEnd(const char *p, const char *end)
+	{
+		const char *q = skipMark(p, end, "<span class='phonetics'>");
+		if (!q)
+			return 0;
+		
+		while (q != end)
+		{
+			if (skipMark(q, end, "<span"))
+			{
+				const char *nested = skipMark(findChar(q + 5, end, '<'), end, "</span>");
+				if (!nested)
+					break;
+				q = nested;
+			}
+			else if (*q == '(' || *q == '<' || *q == '/' || *q == ')')
+				break;
+			else
+				++q;
+		}
+		return skipMark(q, end, "</span>");
+	}
+	
+	// superscripts: <sup>[^<]*</sup>
+	const char *superscriptEnd(const char *p, const char *end)
+	{
+		const char *q = skipMark(p, end, "<sup>");
+		return q ? skipMark(findChar(q, end, '<'), end, "</sup>") : 0;
+	}
+	
+	// numeration using roman digits: <span[^<]*>[IV]*.</span>
+	const char *romanEnd(const char *p, const char *end)
+	{
+		const char *q = skipMark(p, end, "<span");
+		if (!q)
+			return 0;
+		
+		// the closing tag is at the first '<', unless that one is the '.' itself
+		const char *close = findChar(q, end, '<');
+		const char *after = skipMark(close, end, "</span>");
+		if (!after && close != end)
+			after = skipMark(++close, end, "</span>");
+		if (!after || close - 1 <= q)
+			return 0;
+		
+		// the '.' is one character, which may take several bytes
+		const char *r = close - 1;
+		while (r != q && ((uchar)*r & 0xc0) == 0x80)
+			--r;
+		
+		// before it there has to be '>' followed by roman digits only
+		while (r != q && (r[-1] == 'I' || r[-1] == 'V'))
+			--r;
+		return (r != q && r[-1] == '>') ? after : 0;
+	}
+	
+	// info about region of usage: <span class="(region|style|category)">.*</span> (minimal)
+	const char *regionEnd(const char *p, const char *end)
+	{
+		const char *q = skipMark(p, end, "<span class=\"");
+		if (!q)
+			return 0;
+		
+		const char *r = skipMark(q, end, "region\">");
+		if (!r)
+			r = skipMark(q, end, "style\">");
+		if (!r)
+			r = skipMark(q, end, "category\">");
+		if (!r)
+			return 0;
+		
+		// parts removed by the rules above do not close the region
+		while ((r = findChar(r, end, '<')) != end)
+		{
+			const char *after = skipMark(r, end, "</span>");
+			if (after)
+				return after;
+			
+			after = phoneticsEnd(r, end);
+			if (!after)
+				after = superscriptEnd(r, end);
+			if (!after)
+				after = romanEnd(r, end);
+			r = after ? after : r + 1;
+		}
+		return 0;
+	}
+	
+	// opening acronym tag: <acronym[^<]*>
+	const char *acronymEnd(const char *p, const char *end)
+	{
+		const char *q = skipMark(p, end, "<acronym");
+		if (!q)
+			return 0;
+		for (const char *r = findChar(q, end, '<'); r != q; --r)
+			if (r[-1] == '>')
+				return r;
+		return 0;
+	}
+	
+	// writes 'c' in UTF-8, never longer than the entity it comes from
+	inline void putUtf8(char *&out, ushort c)
+	{
+		if (c < 0x80)
+			*out++ = c;
+		else if (c < 0x800)
+		{
+			*out++ = 0xc0 | (c >> 6);
+			*out++ = 0x80 | (c & 0x3f);
+		}
+		else
+		{
+			*out++ = 0xe0 | (c >> 12);
+			*out++ = 0x80 | ((c >> 6) & 0x3f);
+			*out++ = 0x80 | (c & 0x3f);
+		}
+	}
+	
+	const char *removedEnd(const char *p, const char *end)
+	{
+		const char *after = phoneticsEnd(p, end);
+		if (!after)
+			after = superscriptEnd(p, end);
+		if (!after)
+			after = romanEnd(p, end);
+		if (!after)
+			after = regionEnd(p, end);
+		if (!after)
+			after = acronymEnd(p, end);
+		if (!after)
+			after = skipMark(p, end, "</acronym>", Qt::CaseInsensitive);
+		return after;
+	}
+	
+	struct Entity
+	{
+		const char *name;
+		ushort code;
+	};
+	
+	// named entities decoded in responses
+	// &lt; &gt; and &amp; are left as they are, the parser looks for them
+	const Entity entities[] =
+	{
+		{ "apos", '\'' },	{ "quot", '"' },	{ "nbsp", 0xa0 },
+		{ "auml", 0xe4 },	{ "ouml", 0xf6 },	{ "uuml", 0xfc },
+		{ "Auml", 0xc4 },	{ "Ouml", 0xd6 },	{ "Uuml", 0xdc },	{ "szlig", 0xdf },
+		{ "agrave", 0xe0 },	{ "acirc", 0xe2 },	{ "ccedil", 0xe7 },	{ "egrave", 0xe8 },
+		{ "eacute", 0xe9 },	{ "ecirc", 0xea },	{ "euml", 0xeb },	{ "icirc", 0xee },
+		{ "iuml", 0xef },	{ "ocirc", 0xf4 },	{ "ugrave", 0xf9 },	{ "ucirc", 0xfb },
+		{ "oelig", 0x153 },	{ "laquo", 0xab },	{ "raquo", 0xbb },
+		{ "ndash", 0x2013 },{ "mdash", 0x2014 },{ "hellip", 0x2026 }
+	};
+	const int entitiesCount = sizeof(entities) / sizeof(Entity);
+	
+	// 'p' points at '&'; returns position after the entity and its character in 'c',
+	// or 0 if it is not an entity to decode
+	const char *decodeEntity(const char *p, const char *end, ushort &c)
+	{
+		const char *q = p + 1;
+		uint code = 0;
+		
+		if (q != end && *q == '#')
+		{
+			++q;
+			bool hex = (q != end && (*q == 'x' || *q == 'X'));
+			if (hex)
+				++q;
+			
+			const char *digits = q;
+			for (; q != end && q - digits < 7; ++q)
+			{
+				ushort d = (uchar)*q;
+				if (d >= '0' && d <= '9')
+					code = code * (hex ? 16 : 10) + (d - '0');
+				else if (hex && (d | 0x20) >= 'a' && (d | 0x20) <= 'f')
+					code = code * 16 + ((d | 0x20) - 'a' + 10);
+				else
+					break;
+			}
+			if (q == digits || q == end || *q != ';')
+				return 0;
+			if (!code || code > 0xffff || code == '<' || code == '>' || code == '&')
+				return 0;
+		}
+		else
+		{
+			const char *name = q;
+			while (q != end && q - name < 8 && (((uchar)*q | 0x20) >= 'a' && ((uchar)*q | 0x20) <= 'z'))
+				++q;
+			if (q == name || q == end || *q != ';')
+				return 0;
+			
+			for (int i = 0; i < entitiesCount && !code; i++)
+			{
+				const char *after = skipMark(name, q, entities[i].name);
+				if (after == q)
+					code = entities[i].code;
+			}
+			if (!code)
+				return 0;
+		}
+		
+		c = code;
+		return q + 1;
+	}
+}
 
 Pons::Pons(TreeModel *model, QObject *parent) : WebDict(model, parent)
 {
@@ -61,63 +302,117 @@ Pons::Pons(TreeModel *model, QObject *parent) : WebDict(model, parent)
 	strToSpeechPart["CONJ"] = CONJ;
 }
 
-int Pons::query(const QString &word)
+Pons::~Pons()
 {
-	QByteArray q = QByteArray(QString("?q="+word+"&l="+sourceLang+targetLang).toAscii());
-	return http->get("/dict/search/mobile-results/?q="+word+"&l="+sourceLang+targetLang);
+	// parse() uses strToSpeechPart
+	waitForParsers();
 }
 
-void Pons::prepareText(QString &text)
+QNetworkReply *Pons::query(const QString &word)
 {
-	text.remove(QRegExp("<span class='phonetics'>((<span([^<])*</span>)|[^(</)])*</span>")); // deletes phonetic transcription
-	text.remove(QRegExp("<sup>[^<]*</sup>")); // deletes superscripts
-	text.remove(QRegExp("<span[^<]*>[IV]*\.</span>")); // deletes numeration using roman digits
-	
-	// remove info about region of usage
-	QRegExp regional = QRegExp("<span class=\"(region|style|category)\">.*</span>");
-	regional.setMinimal(1);
-	text.remove(regional);
+	QUrl url(website);
+	url.setPath("/dict/search/mobile-results/");
+	url.addQueryItem("q", word);
+	url.addQueryItem("l", sourceLang+targetLang);
+	return network->get(QNetworkRequest(url));
+}
+
+QByteArray Pons::prepareText(const QByteArray &data)
+{
+	// the result is never longer than the data, so it is written to a buffer allocated once
+	QByteArray result;
+	result.resize(data.size());
+	char *out = result.data();
 	
-	text.remove(QRegExp("<acronym[^<]*>"));
-	text.remove("</acronym>", Qt::CaseInsensitive);
+	const char *p = data.constData();
+	const char *end = p + data.size();
+	while (p != end)
+	{
+		if (*p == '<')
+		{
+			const char *after = removedEnd(p, end);
+			if (after)
+			{
+				p = after;
+				continue;
+			}
+		}
+		else if (*p == '&')
+		{
+			ushort c;
+			const char *after = decodeEntity(p, end, c);
+			if (after)
+			{
+				p = after;
+				putUtf8(out, c);
+				continue;
+			}
+		}
+		*out++ = *p++;
+	}
 	
-	text.replace("&#39;","'");
+	result.resize(out - result.constData());
+	return result;
 }
 
-void Pons::parse(const QByteArray &data, const QModelIndex &index)
+void Pons::parse(const QByteArray &data, TreeItem *root)
 {
-	QString text = QString().fromUtf8(data.data());
-	prepareText(text);
+	// the response is scanned as UTF-8, only parts passed to the helpers are decoded
+	QByteArray text = prepareText(data);
 	
-	QList<QModelIndex> parents;
-	parents.append(index);
-	QString word = index.data().toString();
+	QList<TreeItem*> parents;
+	parents.append(root);
+	StringPool::Id word = root->stringId(TreeItem::WordRole);
 	
-	detach(text, "(romhead|$)");
+	// the text is walked once by a cursor 'pos', parts of it are decoded for the helpers only
+	// sections of the response end with "romhead" (the last one with the end of the text)
+	int size = text.size();
+	int pos = findAfter(text, "romhead", 0, size);
+	if (pos == -1)
+		pos = size;
 	
-	while (text.contains("target"))
+	while (findAfter(text, "target", pos, size) != -1)
 	{
-		QString section = detach(text, "(romhead|$)");
-		header(detach(section,"</h2>"), word, parents);
+		int sectionEnd = findAfter(text, "romhead", pos, size);
+		if (sectionEnd == -1)
+			sectionEnd = size;
+		
+		int headerEnd = findAfter(text, "</h2>", pos, sectionEnd);
+		if (headerEnd != -1)
+		{
+			header(QString::fromUtf8(text.constData() + pos, headerEnd - pos), word, parents);
+			pos = headerEnd;
+		}
+		else
+			header(QString(), word, parents);
 		
 		// context
 		bool bSense = 0;
-		while (section.contains("target"))
+		while (findAfter(text, "target", pos, sectionEnd) != -1)
 		{
-			QString findSense = detach(section,"<tr id");
-			QString sense = getSense(findSense);
-			
-			if (!sense.isEmpty())
+			int senseEnd = findAfter(text, "<tr id", pos, sectionEnd);
+			if (senseEnd != -1)
 			{
-				if (bSense)
-					parents.removeLast(); // remove parent
-				QModelIndex idx = model->addContext(sense, parents.last());
-				parents.append(idx); // add parent
-				bSense = 1;
+				QString sense = getSense(QString::fromUtf8(text.constData() + pos, senseEnd - pos));
+				pos = senseEnd;
+				
+				if (!sense.isEmpty())
+				{
+					if (bSense)
+						parents.removeLast(); // remove parent
+					parents.append(parents.last()->addContext(sense)); // add parent
+					bSense = 1;
+				}
 			}
 			
-			QString findTrans = detach(section,"</tr>");
-			finalLevel(findTrans, parents);
+			int transEnd = findAfter(text, "</tr>", pos, sectionEnd);
+			if (transEnd != -1)
+			{
+				finalLevel(QString::fromUtf8(text.constData() + pos, transEnd - pos), parents);
+				pos = transEnd;
+			}
+			else if (senseEnd == -1)
+				break; // no more rows, only some stray "target"
 		}
 		if (bSense)
 		{
@@ -125,22 +420,18 @@ void Pons::parse(const QByteArray &data, const QModelIndex &index)
 			bSense = 0;
 		}
 		parents.removeLast();
+		pos = sectionEnd;
 	}
-	QModelIndex mainWord = parents.takeFirst();
-
-	updateMainWordDetails(mainWord);
-
-	//model->simplify(index);
 }
 
-void Pons::finalLevel(const QString &text, const QList<QModelIndex> &parents)
+void Pons::finalLevel(const QString &text, const QList<TreeItem*> &parents)
 {
 	int pos = 0;
 	QString source = getSource(text, pos);
 	
 	while (pos != -1)
 	{
-		QModelIndex idx = model->addStdWord(source, STD, parents.last());
+		TreeItem *item = parents.last()->addStdWord(source, STD);
 		
 		// ------ translation ------------
 		if (pos != -1)
@@ -152,7 +443,7 @@ void Pons::finalLevel(const QString &text, const QList<QModelIndex> &parents)
 			target.replace(r, " ");
 			target.replace(QRegExp(" +(m|f|nt|pl)(pl)*( +|$)"), " ");
 			
-			model->addTargetWord(target, idx);
+			item->addTargetWord(target, targetLangId);
 		}
 		// -------------------------------
 		
@@ -160,7 +451,7 @@ void Pons::finalLevel(const QString &text, const QList<QModelIndex> &parents)
 	}
 }
 
-bool Pons::header(const QString &text, const QString &sourceWord, QList<QModelIndex> &parents)
+bool Pons::header(const QString &text, StringPool::Id sourceWord, QList<TreeItem*> &parents)
 	// returns true whether exactly the same word as sourceWord was found in a header
 {
 	bool exactWordFound = 0;
@@ -182,20 +473,21 @@ bool Pons::header(const QString &text, const QString &sourceWord, QList<QModelIn
 		
 		Gender g = getGender(text);
 		
-		QModelIndex newItem;
-		if (word.toLower() == sourceWord.toLower())
+		TreeItem *newItem;
+		// the word is interned anyway by the item made of it
+		if (StringPool::equal(StringPool::intern(word), sourceWord, Qt::CaseInsensitive))
 		{
 			exactWordFound = 1;
 			
 			// if there is info about speech part
 			if (speechPart)
-				newItem = model->addStdWord("", SPEECHPART, parents.last(), pl, speechPart, g);
+				newItem = parents.last()->addStdWord("", SPEECHPART, pl, speechPart, g);
 			else
 				// nothing will be added
-				parents.append(parents.last());
+				newItem = parents.last();
 		}
 		else
-			newItem = model->addStdWord(word, STD, parents.last(), pl, speechPart, g);
+			newItem = parents.last()->addStdWord(word, STD, pl, speechPart, g);
 		
 		// adds new item to the parent list
 		parents.append(newItem);
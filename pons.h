@@ -51,11 +51,12 @@ class Pons : public WebDict
 
 public:
     Pons(TreeModel *model, QObject *parent = 0);
-	void parse(const QByteArray &data, const QModelIndex &index);
+	~Pons();
+	void parse(const QByteArray &data, TreeItem *root);
 	
 private:
-	int query(const QString &word);
-	void prepareText(QString &text);
+	QNetworkReply *query(const QString &word);
+	QByteArray prepareText(const QByteArray &data);
 	
 	// some parsing helper functions
 	WordClass getSpeechPart(const QString &text, int pos);
@@ -66,10 +67,10 @@ private:
 	Gender getGender(const QString &text);
 
 	// header is a second level of translation information after the words loaded from a html file
-	bool header(const QString &text, const QString &sourceWord, QList<QModelIndex> &parents);
+	bool header(const QString &text, StringPool::Id sourceWord, QList<TreeItem*> &parents);
 	
 	// function gets the pair of a final source word and a target word
-	void finalLevel(const QString &text, const QList<QModelIndex> &parents);
+	void finalLevel(const QString &text, const QList<TreeItem*> &parents);
 	
 	// map to translate WordClass enums to strings
 	QMap<QString, WordClass> strToSpeechPart;
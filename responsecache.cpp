@@ -0,0 +1,321 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "responsecache.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QNetworkRequest>
+#include <QtAlgorithms>
+
+namespace
+{
+	const quint32 cacheMagic = 0x52534341; // "RSCA"
+	const qint32 cacheVersion = 1;
+	const char cacheSuffix[] = ".cache";
+	
+	bool lessUsed(const QPair<quint64, QString> &a, const QPair<quint64, QString> &b)
+	{
+		return a.first < b.first;
+	}
+}
+
+ResponseCache::ResponseCache(const QString &directory, QObject *parent) :
+	QAbstractNetworkCache(parent), directory(directory)
+{
+	timeToLive = 7*24*60*60; // dictionary entries hardly ever change
+	maximumSize = 50*1024*1024;
+	size = 0;
+	clock = 0;
+	
+	QDir dir(directory);
+	dir.mkpath(".");
+	
+	// files used before are ordered by the time they were written, the oldest first
+	QFileInfoList files = dir.entryInfoList(QStringList() << QString("*") + cacheSuffix,
+											QDir::Files, QDir::Time | QDir::Reversed);
+	foreach (const QFileInfo &info, files)
+	{
+		Entry entry;
+		entry.size = info.size();
+		entry.used = ++clock;
+		entries.insert(info.absoluteFilePath(), entry);
+		size += entry.size;
+	}
+	expire();
+}
+
+ResponseCache::~ResponseCache()
+{
+	qDeleteAll(prepared.keys());
+}
+
+void ResponseCache::setTimeToLive(int seconds)
+{
+	timeToLive = qMax(0, seconds);
+}
+
+void ResponseCache::setMaximumSize(qint64 size)
+{
+	maximumSize = qMax<qint64>(0, size);
+	expire();
+}
+
+QString ResponseCache::fileName(const QUrl &url) const
+{
+	QByteArray hash = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex();
+	return QDir(directory).absoluteFilePath(QString::fromLatin1(hash) + cacheSuffix);
+}
+
+bool ResponseCache::read(const QString &file, QNetworkCacheMetaData *metaData, QByteArray *body)
+{
+	QFile f(file);
+	if (!f.open(QIODevice::ReadOnly))
+		return 0;
+	
+	QDataStream in(&f);
+	in.setVersion(QDataStream::Qt_4_6);
+	quint32 magic;
+	qint32 version;
+	in >> magic >> version;
+	if (magic != cacheMagic || version != cacheVersion)
+	{
+		f.close();
+		removeFile(file);
+		return 0;
+	}
+	in >> *metaData;
+	if (body)
+		in >> *body;
+	
+	if (in.status() != QDataStream::Ok)
+	{
+		f.close();
+		removeFile(file);
+		return 0;
+	}
+	return 1;
+}
+
+bool ResponseCache::write(const QString &file, const QNetworkCacheMetaData &metaData, const QByteArray &body)
+{
+	// write aside and replace, so a crash never leaves half of an entry
+	QString temp = file + ".tmp";
+	QFile f(temp);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return 0;
+	
+	QDataStream out(&f);
+	out.setVersion(QDataStream::Qt_4_6);
+	out << cacheMagic << cacheVersion << metaData << body;
+	f.close();
+	if (out.status() != QDataStream::Ok)
+	{
+		QFile::remove(temp);
+		return 0;
+	}
+	
+	removeFile(file);
+	if (!QFile::rename(temp, file))
+	{
+		QFile::remove(temp);
+		return 0;
+	}
+	
+	Entry entry;
+	entry.size = QFileInfo(file).size();
+	entry.used = ++clock;
+	entries.insert(file, entry);
+	size += entry.size;
+	return 1;
+}
+
+QNetworkCacheMetaData ResponseCache::applyPolicy(QNetworkCacheMetaData metaData) const
+{
+	// QNetworkAccessManager reads these headers back from the cache, so they would force
+	// a full download or a revalidation on every request
+	QNetworkCacheMetaData::RawHeaderList headers;
+	foreach (const QNetworkCacheMetaData::RawHeader &header, metaData.rawHeaders())
+	{
+		QByteArray name = header.first.toLower();
+		if (name != "cache-control" && name != "pragma" && name != "expires")
+			headers.append(header);
+	}
+	metaData.setRawHeaders(headers);
+	metaData.setExpirationDate(QDateTime::currentDateTime().addSecs(timeToLive));
+	metaData.setSaveToDisk(1);
+	return metaData;
+}
+
+void ResponseCache::touch(const QString &file)
+{
+	QHash<QString, Entry>::iterator it = entries.find(file);
+	if (it != entries.end())
+		it->used = ++clock;
+}
+
+void ResponseCache::removeFile(const QString &file)
+{
+	QHash<QString, Entry>::iterator it = entries.find(file);
+	if (it != entries.end())
+	{
+		size -= it->size;
+		entries.erase(it);
+	}
+	QFile::remove(file);
+}
+
+void ResponseCache::expire()
+{
+	if (size <= maximumSize)
+		return;
+	
+	QList<QPair<quint64, QString> > byUse;
+	for (QHash<QString, Entry>::const_iterator it = entries.constBegin(); it != entries.constEnd(); ++it)
+		byUse.append(qMakePair(it->used, it.key()));
+	qSort(byUse.begin(), byUse.end(), lessUsed);
+	
+	// leave some room, so that not every insert has to expire
+	qint64 goal = maximumSize * 9 / 10;
+	for (int i = 0; i < byUse.size() && size > goal; i++)
+		removeFile(byUse[i].second);
+}
+
+QNetworkCacheMetaData ResponseCache::metaData(const QUrl &url)
+{
+	QString file = fileName(url);
+	if (!entries.contains(file))
+		return QNetworkCacheMetaData();
+	
+	QNetworkCacheMetaData result;
+	if (!read(file, &result))
+		return QNetworkCacheMetaData();
+	touch(file);
+	return result;
+}
+
+void ResponseCache::updateMetaData(const QNetworkCacheMetaData &metaData)
+{
+	// called after '304 Not Modified', the body is still valid and stays compressed
+	QString file = fileName(metaData.url());
+	QNetworkCacheMetaData old;
+	QByteArray body;
+	if (!entries.contains(file) || !read(file, &old, &body))
+		return;
+	
+	if (write(file, applyPolicy(metaData), body))
+		expire();
+}
+
+QIODevice *ResponseCache::data(const QUrl &url)
+{
+	QString file = fileName(url);
+	QNetworkCacheMetaData metaData;
+	QByteArray body;
+	if (!entries.contains(file) || !read(file, &metaData, &body))
+		return 0;
+	touch(file);
+	
+	QBuffer *buffer = new QBuffer;
+	buffer->setData(qUncompress(body));
+	buffer->open(QIODevice::ReadOnly);
+	return buffer;
+}
+
+bool ResponseCache::remove(const QUrl &url)
+{
+	// drop unfinished downloads of the url too
+	QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = prepared.begin();
+	while (it != prepared.end())
+	{
+		if (it->url() == url)
+		{
+			delete it.key();
+			it = prepared.erase(it);
+		}
+		else
+			++it;
+	}
+	
+	QString file = fileName(url);
+	if (!entries.contains(file))
+		return 0;
+	removeFile(file);
+	return 1;
+}
+
+QIODevice *ResponseCache::prepare(const QNetworkCacheMetaData &metaData)
+{
+	// only complete pages are worth keeping
+	QVariant status = metaData.attributes().value(QNetworkRequest::HttpStatusCodeAttribute);
+	if (!metaData.isValid() || (status.isValid() && status.toInt() != 200))
+		return 0;
+	
+	QBuffer *buffer = new QBuffer;
+	buffer->open(QIODevice::WriteOnly);
+	prepared.insert(buffer, applyPolicy(metaData));
+	return buffer;
+}
+
+void ResponseCache::insert(QIODevice *device)
+{
+	QHash<QIODevice*, QNetworkCacheMetaData>::iterator it = prepared.find(device);
+	if (it == prepared.end())
+		return;
+	
+	QNetworkCacheMetaData metaData = it.value();
+	prepared.erase(it);
+	
+	QByteArray body = qCompress(static_cast<QBuffer*>(device)->data());
+	device->deleteLater();
+	
+	if (write(fileName(metaData.url()), metaData, body))
+		expire();
+}
+
+void ResponseCache::clear()
+{
+	foreach (const QString &file, entries.keys())
+		QFile::remove(file);
+	entries.clear();
+	size = 0;
+}
@@ -0,0 +1,112 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef RESPONSECACHE_H
+#define RESPONSECACHE_H
+
+#include <QAbstractNetworkCache>
+#include <QHash>
+#include <QUrl>
+
+class ResponseCache : public QAbstractNetworkCache
+	// disk cache of http replies used by QNetworkAccessManager
+	// bodies are stored compressed, one file per url
+	// an entry is fresh for 'timeToLive' seconds, after that QNetworkAccessManager revalidates it
+	// with a conditional request (If-None-Match, If-Modified-Since) and gets only '304 Not Modified' if it hasn't changed
+	// when the cache grows over 'maximumSize' the least recently used entries are removed
+{
+	Q_OBJECT
+public:
+	explicit ResponseCache(const QString &directory, QObject *parent = 0);
+	~ResponseCache();
+	
+	QString getDirectory() const { return directory; }
+	
+	// in seconds
+	int getTimeToLive() const { return timeToLive; }
+	void setTimeToLive(int seconds);
+	
+	// in bytes of compressed files
+	qint64 getMaximumSize() const { return maximumSize; }
+	void setMaximumSize(qint64 size);
+	
+	// QAbstractNetworkCache
+	QNetworkCacheMetaData metaData(const QUrl &url);
+	void updateMetaData(const QNetworkCacheMetaData &metaData);
+	QIODevice *data(const QUrl &url);
+	bool remove(const QUrl &url);
+	qint64 cacheSize() const { return size; }
+	QIODevice *prepare(const QNetworkCacheMetaData &metaData);
+	void insert(QIODevice *device);
+	
+public slots:
+	void clear();
+	
+private:
+	struct Entry
+	{
+		qint64 size; // of the file
+		quint64 used; // value of 'clock' at the last use
+	};
+	
+	QString fileName(const QUrl &url) const;
+	
+	// reads the entry, 'body' is left compressed; a broken file is removed
+	bool read(const QString &file, QNetworkCacheMetaData *metaData, QByteArray *body = 0);
+	bool write(const QString &file, const QNetworkCacheMetaData &metaData, const QByteArray &body);
+	
+	// makes the entry fresh for 'timeToLive' seconds no matter what the server said about caching
+	// validators (ETag, Last-Modified) are kept for revalidation
+	QNetworkCacheMetaData applyPolicy(QNetworkCacheMetaData metaData) const;
+	
+	void touch(const QString &file);
+	void removeFile(const QString &file);
+	// removes the least recently used entries until the cache fits in 'maximumSize'
+	void expire();
+	
+	QString directory;
+	int timeToLive;
+	qint64 maximumSize;
+	qint64 size;
+	quint64 clock;
+	
+	QHash<QString, Entry> entries; // by file name
+	QHash<QIODevice*, QNetworkCacheMetaData> prepared; // bodies being downloaded
+};
+
+#endif // RESPONSECACHE_H
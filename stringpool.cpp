@@ -0,0 +1,139 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "stringpool.h"
+
+#include <QHash>
+#include <QReadWriteLock>
+
+// defined, because it is bound to const references, e.g. by QHash::value()
+const StringPool::Id StringPool::empty;
+
+namespace
+{
+	// strings are kept in chunks allocated once, so adding a string never moves the others
+	const int chunkBits = 12;
+	const quint32 chunkSize = 1 << chunkBits;
+	const quint32 maxChunks = 4096; // 16M strings
+	
+	struct Entry
+	{
+		QString s;
+		StringPool::Id folded;
+	};
+	
+	// constant initialized, the rest is created on the first use
+	Entry *chunks[maxChunks];
+	quint32 count = 1; // id 0 is the empty string
+	
+	typedef QHash<QString, StringPool::Id> IdHash;
+	Q_GLOBAL_STATIC(IdHash, ids)
+	Q_GLOBAL_STATIC(QReadWriteLock, lock)
+	Q_GLOBAL_STATIC(QString, emptyString)
+	
+	Entry &entry(StringPool::Id id)
+	{
+		return chunks[id >> chunkBits][id & (chunkSize - 1)];
+	}
+	
+	// the write lock has to be held, 's' is not in the pool
+	StringPool::Id add(const QString &s)
+	{
+		quint32 chunk = count >> chunkBits;
+		if (chunk >= maxChunks)
+			qFatal("StringPool: too many strings");
+		if (!chunks[chunk])
+			chunks[chunk] = new Entry[chunkSize];
+		
+		StringPool::Id id = count++;
+		Entry &e = entry(id);
+		e.s = s;
+		ids()->insert(s, id);
+		
+		QString lower = s.toLower();
+		if (lower == s)
+			e.folded = id;
+		else
+		{
+			StringPool::Id lowerId = ids()->value(lower, StringPool::empty);
+			e.folded = lowerId != StringPool::empty ? lowerId : add(lower);
+		}
+		return id;
+	}
+}
+
+StringPool::Id StringPool::intern(const QString &s)
+{
+	if (s.isEmpty())
+		return empty;
+	
+	// most strings are there already
+	lock()->lockForRead();
+	IdHash::const_iterator it = ids()->constFind(s);
+	bool found = it != ids()->constEnd();
+	Id id = found ? it.value() : empty;
+	lock()->unlock();
+	if (found)
+		return id;
+	
+	QWriteLocker locker(lock());
+	it = ids()->constFind(s);
+	if (it != ids()->constEnd())
+		return it.value(); // added by another thread in the meantime
+	return add(s);
+}
+
+const QString &StringPool::string(Id id)
+{
+	if (id == empty)
+		return *emptyString();
+	return entry(id).s;
+}
+
+StringPool::Id StringPool::folded(Id id)
+{
+	if (id == empty)
+		return empty;
+	return entry(id).folded;
+}
+
+int StringPool::size()
+{
+	QReadLocker locker(lock());
+	return count - 1;
+}
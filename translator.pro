@@ -19,7 +19,12 @@ SOURCES += main.cpp\
     resultmodel.cpp \
     pons.cpp \
     translatechooser.cpp \
-    addwordlineedit.cpp
+    addwordlineedit.cpp \
+    responsecache.cpp \
+    lookupstore.cpp \
+    localdict.cpp \
+    stringpool.cpp \
+    treearena.cpp
 
 HEADERS  += mainwindow.h \
     webdict.h \
@@ -29,7 +34,12 @@ HEADERS  += mainwindow.h \
     resultmodel.h \
     pons.h \
     translatechooser.h \
-    addwordlineedit.h
+    addwordlineedit.h \
+    responsecache.h \
+    lookupstore.h \
+    localdict.h \
+    stringpool.h \
+    treearena.h
 
 FORMS    += mainwindow.ui
 
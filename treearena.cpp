@@ -0,0 +1,140 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include "treearena.h"
+#include "treeitem.h"
+
+#include <new>
+
+namespace
+{
+	struct Slot
+	{
+		// the item is at the beginning, so a pointer to it is a pointer to the slot
+		union
+		{
+			char storage[sizeof(TreeItem)];
+			void *alignPointer;
+			qint64 alignInt;
+			double alignDouble;
+		};
+		bool alive;
+	};
+	
+	const int firstBlockSlots = 16; // most trees are small
+	const int maxBlockSlots = 1024;
+}
+
+struct TreeArena::Block
+{
+	Block *next;
+	int capacity;
+	int used;
+	Slot slots[1]; // 'capacity' slots in fact
+	
+	static Block *create(int capacity, Block *next)
+	{
+		Block *block = (Block*)::operator new(sizeof(Block) + (capacity - 1) * sizeof(Slot));
+		block->next = next;
+		block->capacity = capacity;
+		block->used = 0;
+		return block;
+	}
+};
+
+TreeArena::TreeArena() : blocks(0)
+{
+}
+
+TreeArena::~TreeArena()
+{
+	clear();
+}
+
+void *TreeArena::allocate()
+{
+	if (!blocks || blocks->used == blocks->capacity)
+		blocks = Block::create(blocks ? qMin(blocks->capacity * 2, maxBlockSlots) : firstBlockSlots, blocks);
+	
+	Slot *slot = blocks->slots + blocks->used++;
+	slot->alive = true;
+	return slot->storage;
+}
+
+void TreeArena::destroy(TreeItem *item)
+{
+	item->~TreeItem();
+	reinterpret_cast<Slot*>(item)->alive = false;
+}
+
+void TreeArena::clear()
+{
+	// parents and children may be in any blocks, so no item is destroyed before
+	// all of them have forgotten their children from the arena, and no block is freed
+	// before all items are destroyed
+	for (Block *block = blocks; block; block = block->next)
+		for (int i = 0; i < block->used; i++)
+			if (block->slots[i].alive)
+				reinterpret_cast<TreeItem*>(block->slots[i].storage)->dropArenaChildren();
+	
+	for (Block *block = blocks; block; block = block->next)
+		for (int i = 0; i < block->used; i++)
+			if (block->slots[i].alive)
+				reinterpret_cast<TreeItem*>(block->slots[i].storage)->~TreeItem();
+	
+	while (blocks)
+	{
+		Block *block = blocks;
+		blocks = block->next;
+		::operator delete(block);
+	}
+}
+
+void TreeArena::take(TreeArena *other)
+{
+	if (!other->blocks)
+		return;
+	
+	// blocks of 'other' go first, the newest of them may have free slots
+	Block *last = other->blocks;
+	while (last->next)
+		last = last->next;
+	last->next = blocks;
+	blocks = other->blocks;
+	other->blocks = 0;
+}
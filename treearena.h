@@ -0,0 +1,75 @@
+/****************************************************************************
+**
+** Copyright (C) 2012 Kamil Neczaj,
+** All rights reserved.
+** Contact: Kamil Neczaj (kneczaj@gmail.com)
+**
+** ** $QT_BEGIN_LICENSE:BSD$
+** You may use this file under the terms of the BSD license as follows:
+**
+** "Redistribution and use in source and binary forms, with or without
+** modification, are permitted provided that the following conditions are
+** met:
+**   * Redistributions of source code must retain the above copyright
+**     notice, this list of conditions and the following disclaimer.
+**   * Redistributions in binary form must reproduce the above copyright
+**     notice, this list of conditions and the following disclaimer in
+**     the documentation and/or other materials provided with the
+**     distribution.
+**   * Neither the name of Nokia Corporation and its Subsidiary(-ies) nor
+**     the names of its contributors may be used to endorse or promote
+**     products derived from this software without specific prior written
+**     permission.
+**
+** THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+** "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+** LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+** A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+** OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+** SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+** LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+** DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+** THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+** (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+** OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE."
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#ifndef TREEARENA_H
+#define TREEARENA_H
+
+class TreeItem;
+
+class TreeArena
+	// memory of the translation tree of one main word
+	// items are allocated one after another in growing blocks and released all at once with the arena,
+	// not one by one; destructors are run by a linear sweep of the blocks, there is no recursion
+	// an arena is used by one thread at a time: a parser builds a tree in it, then it is given to the model
+{
+public:
+	TreeArena();
+	~TreeArena();
+	
+	// memory for one TreeItem, to be constructed with placement new
+	void *allocate();
+	
+	// runs the destructor of a single item, its memory is released with the arena
+	static void destroy(TreeItem *item);
+	
+	// destroys all items and releases the memory
+	void clear();
+	
+	// takes all items of 'other', which is left empty
+	void take(TreeArena *other);
+	
+private:
+	struct Block;
+	Block *blocks; // the newest first
+	
+	// not copyable
+	TreeArena(const TreeArena&);
+	TreeArena &operator=(const TreeArena&);
+};
+
+#endif // TREEARENA_H
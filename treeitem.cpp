@@ -45,43 +45,176 @@
 #include <QObject>
 #include <QStringList>
 
+#include <new>
+
 #include "treeitem.h"
 
+namespace
+{
+	// the only language with articles and capital nouns so far
+	const StringPool::Id langDe = StringPool::intern("de");
+}
+
 TreeItem::TreeItem(TreeItem *parentItem)
 {
 	this->parentItem = parentItem;
+	id = 0;
+	subtree = 0;
+	inArena = 0;
+	rowNumber = 0;
 
 	// by default copy parent
 	if (parentItem)
 	{
-		d = parentItem->itemData();
+		copyFields(parentItem);
 	}
 	// if no parent init by default values
 	else
 	{	
-		d[WordRole] = "";
-		for (int i=Qt::UserRole; i<Qt::UserRole+4; i++)
-			d[i] = "";
-		
-		d[WordClassRole] = WNA;
-		d[GenderRole]= GNA;
-		d[TypeRole] = STD;
+		wordStr = pluralStr = contextStr = langStr = StringPool::empty;
+		wordClassField = WNA;
+		genderField = GNA;
+		typeField = STD;
 	}
 }
 
+void TreeItem::copyFields(const TreeItem *item)
+{
+	wordStr = item->wordStr;
+	pluralStr = item->pluralStr;
+	contextStr = item->contextStr;
+	langStr = item->langStr;
+	typeField = item->typeField;
+	genderField = item->genderField;
+	wordClassField = item->wordClassField;
+}
+
 TreeItem::~TreeItem()
 {
-	qDeleteAll(childItems);
+	// items in an arena are destroyed with the arena, which drops them from the lists first
+	foreach (TreeItem *child, childItems)
+		if (!child->inArena)
+			delete child;
+	delete subtree;
+}
+
+void TreeItem::useArena()
+{
+	if (!subtree)
+		subtree = new TreeArena;
+}
+
+TreeItem *TreeItem::arenaOwner()
+{
+	for (TreeItem *i = this; i; i = i->parentItem)
+		if (i->subtree)
+			return i;
+	return 0;
+}
+
+TreeItem *TreeItem::newChild()
+{
+	TreeItem *owner = arenaOwner();
+	TreeItem *item;
+	if (owner)
+	{
+		item = new (owner->subtree->allocate()) TreeItem(this);
+		item->inArena = 1;
+	}
+	else
+		item = new TreeItem(this);
+	
+	item->rowNumber = childItems.size();
+	childItems.append(item);
+	return item;
+}
+
+void TreeItem::adoptArena(TreeItem *tree)
+{
+	if (!tree->subtree)
+		return;
+	
+	TreeItem *owner = arenaOwner();
+	if (owner)
+		owner->subtree->take(tree->subtree);
+	else
+	{
+		subtree = tree->subtree;
+		tree->subtree = 0;
+	}
+}
+
+void TreeItem::dropArenaChildren()
+{
+	for (int i = childItems.size() - 1; i >= 0; i--)
+		if (childItems.at(i)->inArena)
+			childItems.removeAt(i);
+}
+
+void TreeItem::release(TreeItem *item)
+{
+	// descendants of an arena owner go with its arena at once
+	// otherwise all children are released here, so the destructor does not see them destroyed
+	if (!item->subtree)
+	{
+		foreach (TreeItem *child, item->childItems)
+			release(child);
+		item->childItems.clear();
+	}
+	
+	if (item->inArena)
+		TreeArena::destroy(item);
+	else
+		delete item;
 }
 
 QMap<int, QVariant> TreeItem::itemData() const
 {
-	return d;
+	QMap<int, QVariant> roles;
+	roles[WordRole] = word();
+	roles[ContextRole] = context();
+	roles[PluralRole] = plural();
+	roles[LangRole] = lang();
+	roles[WordClassRole] = wordClassField;
+	roles[GenderRole] = genderField;
+	roles[TypeRole] = typeField;
+	return roles;
 }
 
 bool TreeItem::setItemData(const QMap<int, QVariant> &roles)
 {
-	d = roles;
+	// fields which are not given are cleared
+	wordStr = pluralStr = contextStr = langStr = StringPool::empty;
+	typeField = STD;
+	genderField = GNA;
+	wordClassField = WNA;
+	
+	for (QMap<int, QVariant>::const_iterator i = roles.constBegin(); i != roles.constEnd(); ++i)
+		setField(i.value(), i.key());
+	return true;
+}
+
+bool TreeItem::setField(const QVariant &data, const int role)
+{
+	switch (role)
+	{
+	case WordRole:
+		wordStr = StringPool::intern(data.toString()); break;
+	case ContextRole:
+		contextStr = StringPool::intern(data.toString()); break;
+	case PluralRole:
+		pluralStr = StringPool::intern(data.toString()); break;
+	case LangRole:
+		langStr = StringPool::intern(data.toString()); break;
+	case WordClassRole:
+		wordClassField = data.toInt(); break;
+	case GenderRole:
+		genderField = data.toInt(); break;
+	case TypeRole:
+		typeField = data.toInt(); break;
+	default:
+		return false;
+	}
 	return true;
 }
 
@@ -98,7 +231,7 @@ int TreeItem::childrenCount() const
 int TreeItem::childNumber() const
 {
 	if (parentItem)
-		return parentItem->childItems.indexOf(const_cast<TreeItem*>(this));
+		return rowNumber;
 	
 	return 0;
 }
@@ -110,32 +243,97 @@ bool TreeItem::validUserRoleNum(const int role)
 
 QVariant TreeItem::data(const int role) const
 {
-	if (role == Qt::DisplayRole)
+	switch (role)
+	{
+	case Qt::DisplayRole:
 		return display();
-	else if (role == Qt::EditRole || validUserRoleNum(role))
-		return d[role];
-	else
+	case WordRole:
+		return word();
+	case ContextRole:
+		return context();
+	case PluralRole:
+		return plural();
+	case LangRole:
+		return lang();
+	case WordClassRole:
+		return (int)wordClassField;
+	case GenderRole:
+		return (int)genderField;
+	case TypeRole:
+		return (int)typeField;
+	default:
 		return QVariant();
+	}
 }
 
 void TreeItem::setData(const QVariant &data, const int role)
 {
-	if (role == Qt::EditRole || validUserRoleNum(role))
+	if (setField(data, role))
 	{
-		d[role] = data;	
 		// nouns in german starts with a capital letter
-		if (lang()=="de" && role == WordClassRole && (WordClass)data.toInt() == NOUN)
+		if (langStr == langDe && role == WordClassRole && (WordClass)data.toInt() == NOUN && !word().isEmpty())
 		{
 			QString s = word();
 			QChar firstChar = s.at(0).toUpper();
 			s.remove(0,1);
 			s.prepend(firstChar);
-			d[WordRole] = s;
+			wordStr = StringPool::intern(s);
 		}
-		dsp = display();
 	}
 }
 
+StringPool::Id TreeItem::stringId(const int role) const
+{
+	switch (role)
+	{
+	case WordRole:
+		return wordStr;
+	case ContextRole:
+		return contextStr;
+	case PluralRole:
+		return pluralStr;
+	case LangRole:
+		return langStr;
+	default:
+		return StringPool::empty;
+	}
+}
+
+void TreeItem::setStringId(StringPool::Id id, const int role)
+{
+	switch (role)
+	{
+	case WordRole:
+		wordStr = id; break;
+	case ContextRole:
+		contextStr = id; break;
+	case PluralRole:
+		pluralStr = id; break;
+	case LangRole:
+		langStr = id; break;
+	}
+}
+
+bool TreeItem::sameDisplay(const TreeItem *other, Qt::CaseSensitivity cs) const
+{
+	// the same as display(): text, article and plural
+	bool speechPart = type() == SPEECHPART;
+	if (speechPart != (other->type() == SPEECHPART))
+		return false;
+	if (speechPart)
+		return wordClass() == other->wordClass();
+	
+	StringPool::Id text = type() == CONTEXT ? contextStr : wordStr;
+	StringPool::Id otherText = other->type() == CONTEXT ? other->contextStr : other->wordStr;
+	bool source = type() == STD || type() == MAIN;
+	bool otherSource = other->type() == STD || other->type() == MAIN;
+	
+	return StringPool::equal(text, otherText, cs)
+		&& StringPool::equal(source ? pluralStr : StringPool::empty,
+							 otherSource ? other->pluralStr : StringPool::empty, cs)
+		&& (source && langStr == langDe ? gender() : GNA) == (otherSource && other->langStr == langDe ? other->gender() : GNA);
+}
+
 QString TreeItem::display() const
 {
 	if (type() == STD || type() == MAIN)
@@ -187,25 +385,31 @@ QStringList TreeItem::childrenWordList()
 void TreeItem::addChildren(int count)
 {
 	for (int row = 0; row < count; row++)
-	{
-		TreeItem *item = new TreeItem(this);
-		childItems.append(item);
-	}
+		newChild();
 }
 
 void TreeItem::addChildren(QList<TreeItem*> &children)
 {
+	int position = childItems.size();
 	foreach (TreeItem* i, children)
 		i->setParent(this);
 	childItems.append(children);
+	renumberChildren(position);
 }
 
 void TreeItem::addChild(TreeItem* child)
 {
 	child->setParent(this);
+	child->rowNumber = childItems.size();
 	childItems.append(child);
 }
 
+void TreeItem::renumberChildren(int position)
+{
+	for (int i = position; i < childItems.size(); i++)
+		childItems[i]->rowNumber = i;
+}
+
 TreeItem *TreeItem::parent()
 {
 	return parentItem;
@@ -216,19 +420,85 @@ bool TreeItem::removeChildren(int position, int count)
 	if (position < 0 || position + count > childItems.size())
 		return false;
 	
+	// the whole translation of a main word is released at once with its arena
+	if (subtree && position == 0 && count == childItems.size())
+	{
+		foreach (TreeItem *child, childItems)
+			if (!child->inArena)
+				delete child;
+		childItems.clear();
+		subtree->clear();
+		return true;
+	}
+	
 	for (int row = 0; row < count; ++row)
-		delete childItems.takeAt(position);
+		release(childItems.at(position + row));
+	childItems.erase(childItems.begin() + position, childItems.begin() + position + count);
+	renumberChildren(position);
 	
 	return true;
 }
 
+TreeItem *TreeItem::addContext(const QString &context)
+{
+	TreeItem *item = newChild();
+	
+	item->setData(CONTEXT, TypeRole);
+	item->setData(context, ContextRole);
+	return item;
+}
+
+TreeItem *TreeItem::addStdWord(const QString &word, const Type type, const QString &plural,
+							   const WordClass wordClass, const Gender gender)
+{
+	TreeItem *item = newChild();
+	
+	item->setData(type, TypeRole);
+	// if not set, they are inherited using the constructor
+	if (!word.isEmpty())
+		item->setData(word, WordRole);
+	if (!plural.isEmpty())
+		item->setData(plural, PluralRole);
+	if (wordClass)
+		item->setData(wordClass, WordClassRole);
+	if (gender)
+		item->setData(gender, GenderRole);
+	return item;
+}
+
+TreeItem *TreeItem::addTargetWord(const QString &word, StringPool::Id lang)
+{
+	TreeItem *item = addStdWord(word, TARGET);
+	item->langStr = lang;
+	return item;
+}
+
+TreeItem *TreeItem::clone() const
+{
+	TreeItem *item = new TreeItem(NULL);
+	item->copyFields(this);
+	item->useArena();
+	cloneChildren(item);
+	return item;
+}
+
+void TreeItem::cloneChildren(TreeItem *to) const
+{
+	foreach (TreeItem *child, childItems)
+	{
+		TreeItem *item = to->newChild();
+		item->copyFields(child);
+		child->cloneChildren(item);
+	}
+}
+
 bool TreeItem::detachChildren(int position, int count)
 {
 	if (position < 0 || position + count > childItems.size())
 		return false;
 	
-	for (int row = 0; row < count; ++row)
-		childItems.removeAt(position);
+	childItems.erase(childItems.begin() + position, childItems.begin() + position + count);
+	renumberChildren(position);
 	
 	return true;
 }
@@ -240,7 +510,7 @@ void TreeItem::setParent(TreeItem* parent)
 
 QString TreeItem::getArticle() const
 {
-	if (lang() == "de")
+	if (langStr == langDe)
 	{
 		switch (gender())
 		{
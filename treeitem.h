@@ -41,9 +41,11 @@
 
 #include <QList>
 #include <QVariant>
-//#include <QVector>
 #include <QMap>
 
+#include "stringpool.h"
+#include "treearena.h"
+
 enum Type { STD=0, MAIN, SPEECHPART, CONTEXT, TARGET };
 enum Gender { GNA=0, M, F, N };
 enum WordClass { WNA=0, NOUN, VERB, ADJ, ADV, PRON, CONJ };
@@ -86,52 +88,100 @@ public:
 	bool setItemData(const QMap<int, QVariant> &roles);
 
 	void setData(const QVariant &data, const int role);
+	
+	// ids of string fields in StringPool, without making QStrings and QVariants
+	StringPool::Id stringId(const int role) const;
+	void setStringId(StringPool::Id id, const int role);
 	void setParent(TreeItem* parent);
 	
+	// the subtree of the item is allocated in its own arena from now on
+	// used for main words and detached trees, which are released at once
+	void useArena();
+	// appends a new child, allocated in the arena of the nearest ancestor having one
+	TreeItem *newChild();
+	// after children of 'tree' were moved here, the memory they live in is moved too
+	void adoptArena(TreeItem *tree);
+	
 	void addChildren(int count);
 	void addChildren(QList<TreeItem*> &children);
 	void addChild(TreeItem* child);
 	bool removeChildren(int position, int count);
 
+	// append a new child inheriting data from this item, used to build detached trees
+	// the same as TreeModel::addContext, addStdWord, addTargetWord but without the model
+	TreeItem *addContext(const QString &context);
+	TreeItem *addStdWord(const QString &word, const Type type, const QString &plural = QString(),
+						 const WordClass wordClass = WNA, const Gender gender = GNA);
+	TreeItem *addTargetWord(const QString &word, StringPool::Id lang);
+
+	// deep copy of the item with its children, without a parent
+	TreeItem *clone() const;
+
 	// detach chidren but do not delete it
 	bool detachChildren(int position, int count);
 	
 	int childNumber() const;
 	int childrenCount() const;
 	
+	// stable id of a main word given by TreeModel, 0 for other items
+	quint64 wordId() const { return id; }
+	void setWordId(quint64 id) { this->id = id; }
+	
 	// returns text to display -> DisplayRole
 	QString display() const;
+	
+	// whether display() of both items is the same, compares ids of fields instead of building strings
+	// speech parts are equal only to speech parts
+	bool sameDisplay(const TreeItem *other, Qt::CaseSensitivity cs = Qt::CaseSensitive) const;
 
 	// returns word + article
 	QString getSource() const;
 	
 private:
 
-	QString dsp; // debug (content to display)
-
-	// it is not sure that storing items in their original types
-	// rather that QVariant would be better
-	// That solution would speed up internal operations
-	// while the current one speeds up data() and setData()
-
-	QMap<int, QVariant> d;
-	//QVariant d[userRolesNum + 1]; // data fields
-
-	// the indices should be optimezed to constants at the time of compilation
-
-	QString word()		const	{ return d[WordRole].toString(); }
-	QString plural()	const	{ return d[PluralRole].toString(); }
-	QString context()	const	{ return d[ContextRole].toString(); }
-	QString lang()		const	{ return d[LangRole].toString(); }
-
-	Gender gender()		const	{ return (Gender)d[GenderRole].toInt(); }
-	Type type()			const	{ return (Type)d[TypeRole].toInt(); }
-	WordClass wordClass() const { return (WordClass)d[WordClassRole].toInt(); }
+	// data fields, strings are kept in StringPool
+	// QVariant is made only by data() and itemData()
+	StringPool::Id wordStr;
+	StringPool::Id pluralStr;
+	StringPool::Id contextStr;
+	StringPool::Id langStr;
+	quint8 typeField;
+	quint8 genderField;
+	quint8 wordClassField;
+	bool inArena; // allocated in an arena of an ancestor, not by new
+	int rowNumber; // index in childItems of the parent, kept by every change of the list
+
+	const QString &word()		const	{ return StringPool::string(wordStr); }
+	const QString &plural()		const	{ return StringPool::string(pluralStr); }
+	const QString &context()	const	{ return StringPool::string(contextStr); }
+	const QString &lang()		const	{ return StringPool::string(langStr); }
+
+	Gender gender()		const	{ return (Gender)genderField; }
+	Type type()			const	{ return (Type)typeField; }
+	WordClass wordClass() const { return (WordClass)wordClassField; }
+	
+	// sets a field without side effects, false if 'role' is not a data role
+	bool setField(const QVariant &data, const int role);
+	void copyFields(const TreeItem *item);
 	
 	QString getArticle() const;
 
 	QList<TreeItem*>	childItems;
 	TreeItem*			parentItem;
+	quint64				id;
+	TreeArena*			subtree; // owned, 0 if descendants are allocated one by one
+	
+	// sets rowNumber of children from 'position' to the end
+	void renumberChildren(int position);
+	
+	friend class TreeArena;
+	
+	TreeItem *arenaOwner();
+	// removes children allocated in an arena from childItems, the destructor deletes the rest
+	void dropArenaChildren();
+	// runs destructors of the item and its descendants, which stay in the arena until it is released
+	static void release(TreeItem *item);
+	void cloneChildren(TreeItem *to) const;
 };
 
 #endif
@@ -41,10 +41,110 @@
 #include "treeitem.h"
 #include "treemodel.h"
 
+namespace
+{
+	const char sessionMagic[4] = {'T', 'R', 'S', 'N'};
+	// version 1 had the languages as the first two strings, which failed for equal languages
+	const quint8 sessionVersion = 2;
+	
+	// string fields of an item in the order of a snapshot
+	const int sessionStrings[] = {TreeItem::WordRole, TreeItem::PluralRole, TreeItem::ContextRole, TreeItem::LangRole};
+	const int sessionStringsNum = sizeof(sessionStrings) / sizeof(sessionStrings[0]);
+	
+	void putNumber(QByteArray &out, quint32 n)
+	{
+		while (n >= 0x80)
+		{
+			out.append(char(n | 0x80));
+			n >>= 7;
+		}
+		out.append(char(n));
+	}
+	
+	bool getNumber(const char *&p, const char *end, quint32 &n)
+	{
+		n = 0;
+		for (int shift = 0; p != end && shift < 32; shift += 7)
+		{
+			uchar c = *p++;
+			n |= quint32(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return 1;
+		}
+		return 0;
+	}
+	
+	quint32 intern(const QString &s, QHash<QString, quint32> &ids, QList<QString> &strings)
+	{
+		QHash<QString, quint32>::const_iterator it = ids.constFind(s);
+		if (it != ids.constEnd())
+			return it.value();
+		quint32 id = strings.size();
+		ids.insert(s, id);
+		strings.append(s);
+		return id;
+	}
+	
+	void saveItem(TreeItem *item, QByteArray &items, QHash<QString, quint32> &ids, QList<QString> &strings)
+	{
+		putNumber(items, item->data(TreeItem::TypeRole).toInt());
+		putNumber(items, item->data(TreeItem::WordClassRole).toInt());
+		putNumber(items, item->data(TreeItem::GenderRole).toInt());
+		for (int i = 0; i < sessionStringsNum; i++)
+			putNumber(items, intern(item->data(sessionStrings[i]).toString(), ids, strings));
+		
+		int count = item->childrenCount();
+		putNumber(items, count);
+		for (int i = 0; i < count; i++)
+			saveItem(item->child(i), items, ids, strings);
+	}
+	
+	// reads children of 'parent' recursively, 'depth' guards against broken files
+	bool loadChildren(TreeItem *parent, quint32 count, const char *&p, const char *end,
+					  const QList<QString> &strings, int depth)
+	{
+		if (depth > 64)
+			return 0;
+		
+		for (quint32 c = 0; c < count; c++)
+		{
+			quint32 type, wordClass, gender, children;
+			quint32 id[sessionStringsNum];
+			if (!getNumber(p, end, type) || !getNumber(p, end, wordClass) || !getNumber(p, end, gender))
+				return 0;
+			if (type > TARGET || wordClass > CONJ || gender > N)
+				return 0;
+			
+			QMap<int, QVariant> d;
+			for (int i = 0; i < sessionStringsNum; i++)
+			{
+				if (!getNumber(p, end, id[i]) || id[i] >= (quint32)strings.size())
+					return 0;
+				d[sessionStrings[i]] = strings.at(id[i]);
+			}
+			d[TreeItem::TypeRole] = (Type)type;
+			d[TreeItem::WordClassRole] = (WordClass)wordClass;
+			d[TreeItem::GenderRole] = (Gender)gender;
+			
+			TreeItem *item = parent->newChild();
+			item->setItemData(d);
+			// a main word, its translation lives in its own arena
+			if (!depth)
+				item->useArena();
+			
+			if (!getNumber(p, end, children) || !loadChildren(item, children, p, end, strings, depth + 1))
+				return 0;
+		}
+		return 1;
+	}
+}
+
 TreeModel::TreeModel(QObject *parent) : QAbstractItemModel(parent)
 {
 	rootItem = new TreeItem(NULL);
 	rootItem->setData(sourceLang, TreeItem::LangRole);
+	sourceLangId = targetLangId = StringPool::empty;
+	lastWordId = 0;
 }
 
 TreeModel::~TreeModel()
@@ -199,11 +299,61 @@ int TreeModel::addRows(int rows, const QModelIndex &parent)
 	
 	beginInsertRows(parent, position, endPos);
 	parentItem->addChildren(rows);
+	if (parentItem == rootItem)
+		registerWords(position, rows);
 	endInsertRows();
 
 	return position;
 }
 
+void TreeModel::attachChildren(const QModelIndex &parent, TreeItem *tree)
+{
+	int count = tree->childrenCount();
+	if (!count)
+		return;
+	
+	QList<TreeItem*> children;
+	for (int i = 0; i < count; i++)
+		children.append(tree->child(i));
+	tree->detachChildren(0, count);
+	
+	QMutexLocker locker(&mutex);
+	insertItems(parent, children, tree);
+}
+
+int TreeModel::insertSubtrees(const QModelIndex &parent, QList<TreeItem*> &trees)
+{
+	QMutexLocker locker(&mutex);
+	return insertItems(parent, trees);
+}
+
+QModelIndex TreeModel::insertSubtree(const QModelIndex &parent, TreeItem *tree)
+{
+	QList<TreeItem*> trees;
+	trees.append(tree);
+	int row = insertSubtrees(parent, trees);
+	return index(row, 0, parent);
+}
+
+int TreeModel::insertItems(const QModelIndex &parent, QList<TreeItem*> &items, TreeItem *tree)
+// returns position of the first item
+{
+	TreeItem *parentItem = getItem(parent);
+	int position = parentItem->childrenCount();
+	if (items.isEmpty())
+		return position;
+	
+	beginInsertRows(parent, position, position + items.size() - 1);
+	parentItem->addChildren(items);
+	if (tree)
+		parentItem->adoptArena(tree);
+	if (parentItem == rootItem)
+		registerWords(position, items.size());
+	endInsertRows();
+	
+	return position;
+}
+
 QModelIndex TreeModel::parent(const QModelIndex &index) const
 {
 	if (!index.isValid())
@@ -225,6 +375,8 @@ bool TreeModel::removeRows(int position, int rows, const QModelIndex &parent)
 	bool result;
 	
 	beginRemoveRows(parent, position, position + rows - 1);
+	if (parentItem == rootItem)
+		unregisterWords(position, rows);
 	result = parentItem->removeChildren(position, rows);
 	endRemoveRows();
 	
@@ -246,53 +398,107 @@ QModelIndex TreeModel::addData(const QModelIndex &parent)
 	return index(row, 0, parent);
 }
 
+TreeItem *TreeModel::newMainWord(const QString &word) const
+{
+	TreeItem *item = new TreeItem(rootItem);
+	item->setData(MAIN, TreeItem::TypeRole);
+	// all fields are set before the insertion, so the view and translate() see the whole word
+	item->setStringId(sourceLangId, TreeItem::LangRole);
+	item->setData(word, TreeItem::WordRole);
+	return item;
+}
+
 QModelIndex TreeModel::addMainWord(const QString &word)
 {
-	QModelIndex newItem = addData(QModelIndex());
-	
-	setData(newItem, MAIN, TreeItem::TypeRole);
-	setData(newItem, word, TreeItem::WordRole);
-	setData(newItem, sourceLang, TreeItem::LangRole);
+	QModelIndex newItem = insertSubtree(QModelIndex(), newMainWord(word));
+	emit translate(newItem);
 	
 	return newItem;
 }
 
-QModelIndex TreeModel::addContext(const QString &context, const QModelIndex &parent)
+void TreeModel::addMainWords(const QStringList &words)
 {
-	QModelIndex newItem = addData(parent);
+	QList<TreeItem*> items;
+	items.reserve(words.size());
+	foreach (const QString &word, words)
+		items.append(newMainWord(word));
 	
-	setData(newItem, CONTEXT, TreeItem::TypeRole);
-	setData(newItem, context, TreeItem::ContextRole);
+	int first = insertSubtrees(QModelIndex(), items);
+	for (int i = first; i < first + words.size(); i++)
+		emit translate(index(i, 0));
+}
+
+quint64 TreeModel::wordId(const QModelIndex &index) const
+{
+	return getItem(index)->wordId();
+}
+
+QModelIndex TreeModel::wordIndex(quint64 id) const
+{
+	TreeItem *item = words.value(id);
+	if (!item)
+		return QModelIndex();
+	return createIndex(item->childNumber(), 0, item);
+}
+
+void TreeModel::registerWords(int position, int count)
+{
+	for (int i = position; i < position + count; i++)
+	{
+		TreeItem *item = rootItem->child(i);
+		item->useArena();
+		item->setWordId(++lastWordId);
+		words.insert(lastWordId, item);
+	}
+}
+
+void TreeModel::unregisterWords(int position, int count)
+{
+	for (int i = qMax(0, position); i < position + count && i < rootItem->childrenCount(); i++)
+		words.remove(rootItem->child(i)->wordId());
+}
+
+QModelIndex TreeModel::addContext(const QString &context, const QModelIndex &parent)
+{
+	TreeItem *item = new TreeItem(getItem(parent));
+	item->setData(CONTEXT, TreeItem::TypeRole);
+	item->setData(context, TreeItem::ContextRole);
 	
-	return newItem;
+	return insertSubtree(parent, item);
 }
 
-QModelIndex TreeModel::addStdWord(const QString &word, const Type type, const QModelIndex &parent, 
-								  const QString &plural, const WordClass wordClass, const Gender gender)
+TreeItem *TreeModel::newStdWord(const QString &word, const Type type, const QModelIndex &parent,
+								const QString &plural, const WordClass wordClass, const Gender gender) const
 {
-	QModelIndex newItem = addData(parent);
+	TreeItem *item = new TreeItem(getItem(parent));
 	
-	setData(newItem, type, TreeItem::TypeRole);
+	item->setData(type, TreeItem::TypeRole);
 	// if not set, they are inherited using the constructor
 	if (!word.isEmpty())
-		setData(newItem, word, TreeItem::WordRole);
+		item->setData(word, TreeItem::WordRole);
 	if (!plural.isEmpty())
-		setData(newItem, plural, TreeItem::PluralRole);
+		item->setData(plural, TreeItem::PluralRole);
 	if (wordClass)
-		setData(newItem, wordClass, TreeItem::WordClassRole);
+		item->setData(wordClass, TreeItem::WordClassRole);
 	if (gender)
-		setData(newItem, gender, TreeItem::GenderRole);
+		item->setData(gender, TreeItem::GenderRole);
 	
-	return newItem;
+	return item;
+}
+
+QModelIndex TreeModel::addStdWord(const QString &word, const Type type, const QModelIndex &parent, 
+								  const QString &plural, const WordClass wordClass, const Gender gender)
+{
+	return insertSubtree(parent, newStdWord(word, type, parent, plural, wordClass, gender));
 }
 
 QModelIndex TreeModel::addTargetWord(const QString &word, const QModelIndex &parent, 
 									 const QString &plural, const WordClass wordClass, const Gender gender)
 {
-	QModelIndex newItem = addStdWord(word, TARGET, parent, plural, wordClass, gender);
-	setData(newItem, targetLang, TreeItem::LangRole);
+	TreeItem *item = newStdWord(word, TARGET, parent, plural, wordClass, gender);
+	item->setStringId(targetLangId, TreeItem::LangRole);
 	
-	return newItem;
+	return insertSubtree(parent, item);
 }
 
 void TreeModel::copy(const QModelIndex &from, const QModelIndex &to)
@@ -312,12 +518,12 @@ void TreeModel::copy(const QModelIndex &from, const QModelIndex &to)
 void TreeModel::skip(const QModelIndex &item, const QModelIndex &inheritor)
 // copy children to inheritor, delete itself
 {
-	int itemsNo = rowCount(item);
-	int first = addRows(itemsNo, inheritor);
-
-	// copy data to the new items
-	for (int i = 0; i < itemsNo; i++)
-		copy(index(i, 0, item), index(first+i, 0, inheritor));
+	// copies of the children are inserted at once
+	TreeItem *itemPtr = getItem(item);
+	QList<TreeItem*> trees;
+	for (int i = 0; i < itemPtr->childrenCount(); i++)
+		trees.append(itemPtr->child(i)->clone());
+	insertSubtrees(inheritor, trees);
 	
 	// delete item with its all children (already copied to the inheritor)
 	removeRows(item.row(), 1, item.parent());
@@ -329,20 +535,18 @@ void TreeModel::simplify(const QModelIndex &item)
 	{
 		// runs simplifing (dropping) nodes to simplify tree structure
 		for (int i=0; i < rowCount(item); i++)
-			if(simplify(index(i,0,item), data(item, Qt::DisplayRole).toString()))
+			if(simplify(index(i,0,item), item))
 				i--;
 	}
 }
 
-bool TreeModel::simplify(const QModelIndex &item, const QString &s)
+bool TreeModel::simplify(const QModelIndex &item, const QModelIndex &mainWord)
 // currently turned off
 {
-	QString display = data(item, Qt::DisplayRole).toString(); // debug
-
 	// runs recursively on all children
 	int count = rowCount(item);
 	for (int i=0; i<count && i<rowCount(item); i++)
-		if(simplify(index(i,0,item), s))
+		if(simplify(index(i,0,item), mainWord))
 			i--;
 	
 	// if the all children were recursively deleted
@@ -357,16 +561,17 @@ bool TreeModel::simplify(const QModelIndex &item, const QString &s)
 	if (item.row() < rowCount(item.parent()) - 1)
 	{
 		QModelIndex next = index(item.row()+1, 0, item.parent());
-		if (next != QModelIndex() && data(item, Qt::DisplayRole) == data(next, Qt::DisplayRole))
+		if (next != QModelIndex() && getItem(item)->sameDisplay(getItem(next)))
 		{
 			skip(item, next);
 			return true;
 		}
 	}
 	
-	QString word = data(item, Qt::DisplayRole).toString().toLower();
 	//	// deletes nodes with the same source word as parent's
-	if (word == s.toLower() || word == data(item.parent(), Qt::DisplayRole).toString().toLower())
+	TreeItem *i = getItem(item);
+	if (i->sameDisplay(getItem(mainWord), Qt::CaseInsensitive)
+		|| i->sameDisplay(getItem(item.parent()), Qt::CaseInsensitive))
 	{
 		skip(item, item.parent());
 		return true;
@@ -382,9 +587,7 @@ bool TreeModel::simplify(const QModelIndex &item, const QString &s)
 		QModelIndex oldParent = item.parent();
 		QModelIndex newParent = oldParent.parent();
 
-		int row = addRows(1, newParent);
-
-		copy(item, index(row, 0, newParent));
+		insertSubtree(newParent, getItem(item)->clone());
 		
 		// delete the old item
 		removeRows(item.row(), 1, oldParent);
@@ -407,4 +610,83 @@ void TreeModel::setLang(const QString sourceLang, const QString targetLang)
 	QMutexLocker locker(&mutex);
 	this->sourceLang = sourceLang;
 	this->targetLang = targetLang;
+	sourceLangId = StringPool::intern(sourceLang);
+	targetLangId = StringPool::intern(targetLang);
+}
+
+bool TreeModel::save(QIODevice *device) const
+{
+	QHash<QString, quint32> ids;
+	QList<QString> strings;
+	QByteArray items;
+	
+	quint32 source = intern(sourceLang, ids, strings);
+	quint32 target = intern(targetLang, ids, strings);
+	
+	int count = rootItem->childrenCount();
+	putNumber(items, count);
+	for (int i = 0; i < count; i++)
+		saveItem(rootItem->child(i), items, ids, strings);
+	
+	QByteArray out;
+	out.append(sessionMagic, sizeof(sessionMagic));
+	out.append(char(sessionVersion));
+	putNumber(out, strings.size());
+	foreach (const QString &s, strings)
+	{
+		QByteArray utf8 = s.toUtf8();
+		putNumber(out, utf8.size());
+		out.append(utf8);
+	}
+	putNumber(out, source);
+	putNumber(out, target);
+	out.append(items);
+	
+	return device->write(out) == out.size();
+}
+
+bool TreeModel::load(QIODevice *device)
+{
+	QByteArray in = device->readAll();
+	const char *p = in.constData();
+	const char *end = p + in.size();
+	
+	if (in.size() < (int)sizeof(sessionMagic) + 1 || memcmp(p, sessionMagic, sizeof(sessionMagic)))
+		return 0;
+	quint8 version = p[sizeof(sessionMagic)];
+	if (version < 1 || version > sessionVersion)
+		return 0;
+	p += sizeof(sessionMagic) + 1;
+	
+	quint32 stringsNum;
+	if (!getNumber(p, end, stringsNum) || stringsNum > (quint32)(end - p))
+		return 0;
+	QList<QString> strings;
+	strings.reserve(stringsNum);
+	for (quint32 i = 0; i < stringsNum; i++)
+	{
+		quint32 size;
+		if (!getNumber(p, end, size) || size > (quint32)(end - p))
+			return 0;
+		strings.append(QString::fromUtf8(p, size));
+		p += size;
+	}
+	
+	quint32 source = 0, target = 1;
+	if (version >= 2 && (!getNumber(p, end, source) || !getNumber(p, end, target)))
+		return 0;
+	if (source >= stringsNum || target >= stringsNum)
+		return 0;
+	
+	// the tree is built aside and attached at once
+	quint32 count;
+	TreeItem tree(NULL);
+	if (!getNumber(p, end, count) || !loadChildren(&tree, count, p, end, strings, 0) || p != end)
+		return 0;
+	
+	if (rowCount())
+		clear();
+	setLang(strings.at(source), strings.at(target));
+	attachChildren(QModelIndex(), &tree);
+	return 1;
 }
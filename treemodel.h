@@ -42,7 +42,10 @@
 #include <QAbstractItemModel>
 #include <QModelIndex>
 #include <QString>
+#include <QStringList>
 #include <QMutex>
+#include <QHash>
+#include <QIODevice>
 
 #include "treeitem.h"
 
@@ -77,6 +80,13 @@ public:
 	// adds various types of nodes
 	QModelIndex addData(const QModelIndex &parent);
 	QModelIndex addMainWord(const QString &word);
+	// appends main words with a single rows insertion, then emits translate() for each of them
+	void addMainWords(const QStringList &words);
+	
+	// main words get ids, which stay valid while rows are inserted or removed; 0 is not an id
+	quint64 wordId(const QModelIndex &index) const;
+	// invalid index if the word has been removed
+	QModelIndex wordIndex(quint64 id) const;
 	QModelIndex addContext(const QString &context, const QModelIndex &parent);
 
 	QModelIndex addStdWord(const QString &word, const Type type, const QModelIndex &parent,
@@ -85,17 +95,37 @@ public:
 	QModelIndex addTargetWord(const QString &word, const QModelIndex &parent,
 							  const QString &plural = QString(), const WordClass wordClass = WNA, const Gender gender = GNA);
 	
+	// moves children of a detached 'tree' (e.g. built by a parser in another thread)
+	// to the end of children of 'parent' with a single rows insertion; 'tree' is left empty
+	void attachChildren(const QModelIndex &parent, TreeItem *tree);
+	
+	// appends fully built subtrees (roots made by new, not in an arena) to children of 'parent'
+	// with a single rows insertion and no dataChanged; the model takes ownership of them
+	// returns the row of the first one
+	int insertSubtrees(const QModelIndex &parent, QList<TreeItem*> &trees);
+	QModelIndex insertSubtree(const QModelIndex &parent, TreeItem *tree);
+	
 	QMap<int, QVariant>	itemData(const QModelIndex& index) const;
 	bool setItemData(const QModelIndex &index, const QMap<int, QVariant> &roles);
 
 	// runs simlification using various criteria to have smaller tree with same information included
 	void simplify(const QModelIndex &index);
-	bool simplify(const QModelIndex &index, const QString &s);
+	bool simplify(const QModelIndex &index, const QModelIndex &mainWord);
 	
 	void skip(const QModelIndex &item, const QModelIndex &inheritor);
 	void copy(const QModelIndex &from, const QModelIndex &to);
 	
 	void setLang(const QString sourceLang, const QString targetLang);
+	QString getSourceLang() const { return sourceLang; }
+	QString getTargetLang() const { return targetLang; }
+	
+	// session snapshot: the whole tree with languages in a compact binary form
+	// strings are stored once in a table (UTF-8, length-prefixed), items and both languages refer to them by number
+	// numbers are varints, items are written depth-first with the number of their children
+	bool save(QIODevice *device) const;
+	// replaces the content of the model, all main words are inserted at once
+	// returns false if the data is not a snapshot of a known version; the model is not changed then
+	bool load(QIODevice *device);
 	
 signals:
 	// signal to a dictionary to translate given item -> get translation tree
@@ -105,9 +135,30 @@ private:
 	TreeItem *getItem(const QModelIndex &index) const;
 	TreeItem *rootItem;
 	
+	// appends 'items' to children of 'parent' and moves the arena of 'tree' with them if given
+	// the mutex has to be locked
+	int insertItems(const QModelIndex &parent, QList<TreeItem*> &items, TreeItem *tree = 0);
+	
+	// a detached main word, to be inserted by insertSubtree(s)
+	TreeItem *newMainWord(const QString &word) const;
+	
+	// a detached item inheriting data from 'parent', to be inserted by insertSubtree
+	TreeItem *newStdWord(const QString &word, const Type type, const QModelIndex &parent,
+						 const QString &plural, const WordClass wordClass, const Gender gender) const;
+	
+	// gives ids to main words in 'count' rows from 'position'
+	void registerWords(int position, int count);
+	void unregisterWords(int position, int count);
+	
+	QHash<quint64, TreeItem*> words; // main words by their ids
+	quint64 lastWordId;
+	
 	QMutex mutex;
 	QString sourceLang;
 	QString targetLang;
+	// interned, set to new items without hashing
+	StringPool::Id sourceLangId;
+	StringPool::Id targetLangId;
 	
 	bool busy;
 };
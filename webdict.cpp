@@ -37,20 +37,44 @@
 ****************************************************************************/
 
 #include "webdict.h"
+#include "responsecache.h"
 
-#include <QHttp>
+#include <QDesktopServices>
 #include <QTextCodec>
+#include <QtConcurrentRun>
 
-WebDict::WebDict(TreeModel *model, QObject *parent) :  QThread(parent), model(model)
+WebDict::WebDict(TreeModel *model, QObject *parent) :  QObject(parent), model(model)
 {
-	connect(model, SIGNAL(translate(QModelIndex)), this, SLOT(translate(QModelIndex)));
-	http = new QHttp(this);
-	connect(http, SIGNAL(requestFinished(int,bool)), this, SLOT(httpFinished(int,bool)) );
+	qRegisterMetaType<TreeItem*>("TreeItem*");
+	
+	network = new QNetworkAccessManager(this);
+	connect(network, SIGNAL(finished(QNetworkReply*)), this, SLOT(httpFinished(QNetworkReply*)));
+	connect(this, SIGNAL(parsed(TreeItem*,QByteArray)),
+			this, SLOT(translationParsed(TreeItem*,QByteArray)), Qt::QueuedConnection);
 	initialized = 0;
+	working = 0;
+	parsing = 0;
+	running = 0;
+	closing = 0;
+	maxRequests = 6;
+	store = 0;
+	targetLangId = StringPool::empty;
 }
 
 WebDict::~WebDict()
 {
+	waitForParsers();
+	// queued parsed() signals are dropped with the object
+	qDeleteAll(parsedRoots);
+	delete store;
+}
+
+void WebDict::waitForParsers()
+{
+	QMutexLocker locker(&mutex);
+	closing = 1;
+	while (running)
+		parsersDone.wait(&mutex);
 }
 
 void WebDict::setLang(const QString &sourceLang, const QString &targetLang)
@@ -59,16 +83,39 @@ void WebDict::setLang(const QString &sourceLang, const QString &targetLang)
 	QString targetLangLc = targetLang.toLower();
 	this->sourceLang = sourceLangLc;
 	this->targetLang = targetLangLc;
+	targetLangId = StringPool::intern(targetLangLc);
 	
 	model->setLang(sourceLangLc, targetLangLc);
 	
+	// 'name' is set by a subclass, so the cache and the store can not be opened in the constructor
+	if (usesNetworkCache())
+	{
+		QString cacheLocation = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+		// pages downloaded before are taken from the disk or only revalidated
+		// every dictionary has its own directory, a cache keeps the size of its files to itself
+		ResponseCache *cache = qobject_cast<ResponseCache*>(network->cache());
+		if (!cache)
+		{
+			cache = new ResponseCache(cacheLocation + "/http/" + name.toLower(), network);
+			network->setCache(cache);
+		}
+		// pages in the store get old like in the cache, so they are downloaded or revalidated again
+		if (!store)
+			store = new LookupStore(cacheLocation + "/" + name.toLower() + ".store", cache->getTimeToLive());
+	}
+	
 	initialized = 1;
 }
 
+void WebDict::setMaxRequests(int max)
+{
+	maxRequests = qMax(1, max);
+	startDownloads();
+}
+
 void WebDict::addWords(const QStringList &list)
 {
-	foreach (const QString &word, list)
-		model->addMainWord(word);
+	model->addMainWords(list);
 }
 
 void WebDict::translateAll()
@@ -80,26 +127,82 @@ void WebDict::translateAll()
 	mutex.lock();
 	while ((child = model->index(i,0)) != QModelIndex())
 	{
-		downloadQueue.enqueue(child);
+		downloadQueue.enqueue(model->wordId(child));
 		i++;
 	}
+	working = 1;
 	mutex.unlock();
 	
-	if (!isRunning())
-		start();
+	startDownloads();
+	checkCompleted(); // there may be no words at all
 }
 
 void WebDict::translate(const QModelIndex &index)
 {
+	// only main words are translated
+	quint64 id = model->wordId(index);
+	if (!id)
+		return;
+	
 	// remove old translation if exists
 	if (model->rowCount(index))
 		model->removeRows(0, model->rowCount(index), index);
 	
 	mutex.lock();
-	downloadQueue.enqueue(index);
+	downloadQueue.enqueue(id);
+	working = 1;
 	mutex.unlock();
-	if (!isRunning())
-		start();
+	
+	startDownloads();
+}
+
+void WebDict::startDownloads()
+{
+	// QNetworkAccessManager has to be used in the main thread
+	QMutexLocker locker(&mutex);
+	if (downloadQueue.isEmpty() || !ready())
+		return;
+	
+	while (replies.size() < maxRequests && !downloadQueue.isEmpty())
+	{
+		quint64 id = downloadQueue.dequeue();
+		QModelIndex item = model->wordIndex(id);
+		if (!item.isValid())
+			continue; // removed in the meantime
+		
+		QString word = item.data(Qt::EditRole).toString();
+		QByteArray key = LookupStore::key(word, sourceLang, targetLang);
+		
+		// the same word is being translated already
+		QHash<QByteArray, QList<quint64> >::iterator waiting = pending.find(key);
+		if (waiting != pending.end())
+		{
+			waiting->append(id);
+			continue;
+		}
+		pending[key].append(id);
+		
+		QByteArray page;
+		if (lookup(word, page))
+		{
+			parsePage(key, page, 0);
+			continue;
+		}
+		
+		// downloaded before, maybe by another instance of the program
+		page = store ? store->find(key) : QByteArray();
+		if (!page.isNull())
+		{
+			parsePage(key, page, 1);
+			continue;
+		}
+		
+		QNetworkReply *reply = query(word);
+		if (reply)
+			replies.insert(reply, key);
+		else
+			pending.remove(key);
+	}
 }
 
 void WebDict::updateMainWordDetails(const QModelIndex &item)
@@ -113,56 +216,147 @@ void WebDict::updateMainWordDetails(const QModelIndex &item)
 	}
 }
 
-void WebDict::httpFinished(int id, bool error)
+void WebDict::httpFinished(QNetworkReply *reply)
 {
-	if (!error)
+	reply->deleteLater();
+	
+	mutex.lock();
+	QHash<QNetworkReply*, QByteArray>::iterator i = replies.find(reply);
+	if (i == replies.end())
 	{
-		int i = replyList.indexOf(ReplayListItem(id));
-		if (i!=-1)
-		{
-			QByteArray *r = new QByteArray(http->readAll());
-			mutex.lock();
-			parserQueue.enqueue( QPair<QByteArray*, QModelIndex>(r, replyList.at(i).word ) );
-			mutex.unlock();
-			replyList.removeAt(i);
-		}
+		mutex.unlock();
+		return;
+	}
+	QByteArray key = i.value();
+	replies.erase(i);
+	
+	if (reply->error() == QNetworkReply::NoError)
+	{
+		QByteArray page = reply->readAll();
+		if (store)
+			store->insert(key, qCompress(page));
+		parsePage(key, page, 0);
 	}
+	else
+		pending.remove(key);
+	mutex.unlock();
+	
+	startDownloads();
+	checkCompleted();
 }
 
-void WebDict::run()
+void WebDict::parsePage(const QByteArray &key, const QByteArray &page, bool compressed)
 {
-	forever
+	// the copy of the main word is taken here, in the main thread
+	// words waiting for the same key differ only in their position
+	QModelIndex word;
+	foreach (quint64 id, pending.value(key))
 	{
-		mutex.lock();
-		// parse
-		while (!parserQueue.isEmpty())
-		{
-			QPair<QByteArray*, QModelIndex> data = parserQueue.dequeue();
-			mutex.unlock();
-			emit parse_signal(*data.first, data.second);
-			delete data.first;
-			mutex.lock();
-		}
-		
-		// download - run in background using QHttp, which has its own thread
-		while ( !downloadQueue.isEmpty() )
-		{
-			QModelIndex item = downloadQueue.dequeue();
-			mutex.unlock();
-			QString word = item.data(Qt::EditRole).toString();
-			http->setHost(website.host());
-			mutex.lock();
-			replyList.append( ReplayListItem(query(word), QModelIndex(item) ) );
-		}
-		
-		// all work completed
-		if (downloadQueue.isEmpty() && parserQueue.isEmpty() && replyList.isEmpty())
-		{
-			mutex.unlock();
-			emit completed();
+		word = waitingWord(id, key);
+		if (word.isValid())
 			break;
-		}
+	}
+	
+	// all the words have been removed or edited in the meantime
+	if (!word.isValid())
+	{
+		pending.remove(key);
+		return;
+	}
+	
+	parsing++;
+	running++;
+	if (compressed)
+		QtConcurrent::run(this, &WebDict::parseStored, page, key, model->itemData(word));
+	else
+		QtConcurrent::run(this, &WebDict::parseDetached, page, key, model->itemData(word));
+}
+
+void WebDict::parseDetached(const QByteArray &data, const QByteArray &key, const QMap<int, QVariant> &wordData)
+{
+	mutex.lock();
+	bool skip = closing;
+	mutex.unlock();
+	
+	if (!skip)
+	{
+		TreeItem *root = new TreeItem(NULL);
+		root->setItemData(wordData);
+		root->useArena(); // moved to the main word with the tree
+		parse(data, root);
+		
+		mutex.lock();
+		parsedRoots.insert(root);
 		mutex.unlock();
+		emit parsed(root, key);
+	}
+	
+	// the object may be destroyed as soon as this is done
+	mutex.lock();
+	running--;
+	parsersDone.wakeAll();
+	mutex.unlock();
+}
+
+void WebDict::parseStored(const QByteArray &compressed, const QByteArray &key, const QMap<int, QVariant> &wordData)
+{
+	parseDetached(qUncompress(compressed), key, wordData);
+}
+
+void WebDict::translationParsed(TreeItem *root, const QByteArray &key)
+{
+	mutex.lock();
+	parsedRoots.remove(root);
+	QList<quint64> ids = pending.take(key);
+	mutex.unlock();
+	
+	// the words may have been removed or edited in the meantime
+	QList<QModelIndex> waiting;
+	foreach (quint64 id, ids)
+	{
+		QModelIndex word = waitingWord(id, key);
+		if (word.isValid() && !model->rowCount(word) && !waiting.contains(word))
+			waiting.append(word);
+	}
+	
+	for (int i = 0; i < waiting.size(); i++)
+	{
+		// the last one takes the tree itself
+		TreeItem *tree = (i == waiting.size() - 1) ? root : root->clone();
+		model->attachChildren(waiting[i], tree);
+		updateMainWordDetails(waiting[i]);
+		if (tree != root)
+			delete tree;
+	}
+	delete root;
+	
+	mutex.lock();
+	parsing--;
+	mutex.unlock();
+	
+	checkCompleted();
+}
+
+QModelIndex WebDict::waitingWord(quint64 id, const QByteArray &key) const
+{
+	// an edited word keeps its id, but is translated again under a new key
+	QModelIndex word = model->wordIndex(id);
+	if (word.isValid() && LookupStore::key(word.data(Qt::EditRole).toString(), sourceLang, targetLang) != key)
+		return QModelIndex();
+	return word;
+}
+
+void WebDict::checkCompleted()
+{
+	mutex.lock();
+	bool idle = downloadQueue.isEmpty() && !parsing && replies.isEmpty();
+	mutex.unlock();
+	
+	// all work completed
+	if (idle && working)
+	{
+		working = 0;
+		emit completed();
 	}
 }
 
@@ -41,28 +41,20 @@
 
 #include "downloader.h"
 #include "treemodel.h"
+#include "lookupstore.h"
 
 #include <QObject>
 #include <QStringList>
+#include <QHash>
+#include <QSet>
 #include <QUrl>
-#include <QHttp>
+#include <QWaitCondition>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
 
-class ReplayListItem
-	// element of http replies list
-{
-public:
-	ReplayListItem(int id, QModelIndex word) : id(id), word(word) {}
-	ReplayListItem(int id) : id(id), word(QModelIndex()) {}
-	
-	int id;
-	QModelIndex word;
-	
-	bool operator ==(ReplayListItem a) { return a.id == id; }
-};
-
-class WebDict : public QThread
+class WebDict : public QObject
 	// abstract class to support a web dictionary, includes downloader
-	// made as QThread to work in background
+	// works in background driven by events: finished downloads and parsers
 {
 	Q_OBJECT
 public:
@@ -71,19 +63,50 @@ public:
 	
 	QString getName() const { return name; }
 	QUrl getWebsite() const { return website; }
+	// base url of requests, e.g. a local stand-in server
+	void setWebsite(const QUrl &url) { website = url; }
 	QStringList getLanguages() const { return languages; }
+
+	// number of requests sent to the dictionary at the same time
+	// QNetworkAccessManager keeps up to 6 connections per host alive and reuses them
+	int getMaxRequests() const { return maxRequests; }
+	void setMaxRequests(int max);
 	
 	void setLang(const QString &sourceLang, const QString &targetLang);
-	virtual void parse(const QByteArray &data, const QModelIndex &index) = 0;
+
+	// builds translation tree of a main word under 'root', which holds a copy of the main word's data
+	// runs in worker threads, so it must not touch the model
+	virtual void parse(const QByteArray &data, TreeItem *root) = 0;
 	
 protected:
 	QStringList languages;
 	QString name;
 	QUrl website;
-	QHttp *http;
+	QNetworkAccessManager *network;
 	
 	void addLanguage(QString language) { languages.append(language); }
 
+	// dictionaries available without the network give the page to parse() here, in the main thread
+	// returns false if query() has to be sent
+	virtual bool lookup(const QString &word, QByteArray &page) { Q_UNUSED(word); Q_UNUSED(page); return 0; }
+	
+	// dictionaries which never download return false, so no response cache and store are opened for them
+	virtual bool usesNetworkCache() const { return 1; }
+	
+	// dictionaries preparing their data in the background return false until it is done, words wait in the queue
+	// then startDownloads() has to be called
+	virtual bool ready() { return 1; }
+	
+	// sends queued requests up to the limit of requests at the same time
+	void startDownloads();
+	
+	// emits completed() if there is nothing more to do
+	void checkCompleted();
+	
+	// waits for parse() running in worker threads, jobs not started yet do not parse any more
+	// the destructor of every subclass calls it first, parse() must not run on a half destroyed object
+	void waitForParsers();
+	
 	// downloads web page
 	QByteArray getPage(QUrl &url);
 	bool expandTranslationTree(const QModelIndex &idx);
@@ -105,6 +128,7 @@ protected:
 	
 	QString sourceLang;
 	QString targetLang;
+	StringPool::Id targetLangId; // for parsers
 	
 	TreeModel *model;
 	
@@ -117,25 +141,55 @@ public slots:
 	void translate(const QModelIndex &index);
 	
 private slots:
-	void httpFinished(int id, bool error);
-	void run();
+	void httpFinished(QNetworkReply *reply);
+
+	// puts a tree built by parse() into the model
+	// every main word waiting for the same 'key' gets a copy
+	void translationParsed(TreeItem *root, const QByteArray &key);
 
 signals:
 	// all work done
 	void completed();
 
-	// temporary solution to make model modifications in main thread
-	void parse_signal(const QByteArray &data, const QModelIndex &index);
+	// parse() has finished in a worker thread
+	void parsed(TreeItem *root, const QByteArray &key);
 	
 private:
-	virtual int query(const QString &word) = 0;
+	// sends request for translation of 'word'
+	virtual QNetworkReply *query(const QString &word) = 0;
 	void getTranslation(const QString &list);
+
+	// the main word 'id' if it still exists and its translation is requested by 'key'
+	QModelIndex waitingWord(quint64 id, const QByteArray &key) const;
+	
+	// starts parsing of a page for main words waiting for 'key', the mutex must be locked
+	void parsePage(const QByteArray &key, const QByteArray &page, bool compressed);
+	
+	// runs parse() in a worker thread on a copy of the main word
+	void parseDetached(const QByteArray &data, const QByteArray &key, const QMap<int, QVariant> &wordData);
+	// the same for a compressed page from the store
+	void parseStored(const QByteArray &compressed, const QByteArray &key, const QMap<int, QVariant> &wordData);
 	
 	bool initialized;
+	bool working; // completed() has not been emitted for the last work yet
+	int maxRequests;
+	
+	// main words are kept by their ids, TreeModel::wordId(), so rows may change in the meantime
+	QQueue<quint64> downloadQueue;
+	int parsing; // replies being parsed in worker threads
+	int running; // parse jobs not finished yet, less than 'parsing' when their trees are on the way
+	bool closing; // set by waitForParsers()
+	QWaitCondition parsersDone;
+	QSet<TreeItem*> parsedRoots; // sent by parsed(), not taken by translationParsed() yet
+	
+	// main words by the key of their request, downloaded or parsed at the moment
+	// the same word added several times is downloaded and parsed once
+	QHash<QByteArray, QList<quint64> > pending;
 	
-	QQueue<QModelIndex> downloadQueue;
-	QQueue< QPair<QByteArray*, QModelIndex> > parserQueue;
-    QList<ReplayListItem> replyList;
+	// pages downloaded before, opened with the first setLang()
+	LookupStore *store;
+	// keys of requests sent, see LookupStore::key()
+	QHash<QNetworkReply*, QByteArray> replies;
 };
 
 #endif // WEBDICT_H